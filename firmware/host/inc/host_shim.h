@@ -0,0 +1,25 @@
+#ifndef HOST_SHIM_H
+#define HOST_SHIM_H
+
+#include <pico/stdlib.h>
+
+// Controls for the simulated Pico SDK state on a host PC.
+// Time does not advance on its own. It only changes when set explicitly, so
+// anything built against the shim runs deterministically.
+
+/**
+ * \brief set the simulated time since boot.
+ */
+void host_set_time_us(uint64_t time_us);
+
+/**
+ * \brief advance the simulated time since boot by \p delta_us.
+ */
+void host_advance_time_us(uint64_t delta_us);
+
+/**
+ * \brief simulated output state of all GPIO pins (bit n is GPIO n).
+ */
+uint32_t host_get_gpio_outputs();
+
+#endif // HOST_SHIM_H
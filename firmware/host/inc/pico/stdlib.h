@@ -0,0 +1,37 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+// Minimal stand-in for the Pico SDK's pico/stdlib.h such that
+// hardware-independent firmware modules (i.e: the LickDetector) can be compiled
+// and run on a host PC. Only the subset of the SDK used by those modules is
+// provided. Time and GPIO state are simulated. See host_shim.h.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define __time_critical_func(func_name) func_name
+#define __not_in_flash_func(func_name) func_name
+#define __not_in_flash(group)
+#define count_of(a) (sizeof(a)/sizeof((a)[0]))
+
+static inline uint32_t __mul_instruction(uint32_t a, uint32_t b)
+{return a * b;}
+
+absolute_time_t get_absolute_time();
+uint64_t time_us_64();
+static inline uint32_t to_ms_since_boot(absolute_time_t t)
+{return uint32_t(t / 1000);}
+static inline uint64_t to_us_since_boot(absolute_time_t t)
+{return t;}
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_put_masked(uint32_t mask, uint32_t value);
+
+#endif // HOST_PICO_STDLIB_H
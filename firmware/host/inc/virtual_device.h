@@ -0,0 +1,146 @@
+#ifndef VIRTUAL_DEVICE_H
+#define VIRTUAL_DEVICE_H
+
+#include <pico/stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <config.h>
+#include <lick_detector.h>
+#include <harp_frame_parser.h>
+
+#define VIRTUAL_DEVICE_MAX_SAMPLES_PER_PERIOD (SAMPLES_PER_PERIOD)
+#define VIRTUAL_DEVICE_ADC_MIDSCALE (2048) // 12-bit ADC.
+#define VIRTUAL_DEVICE_OUTPUT_LIMIT (1ul << 20) // pending bytes before events
+                                                // are dropped.
+
+// Harp payload types.
+#define HARP_U8 (0x01)
+#define HARP_U16 (0x02)
+#define HARP_U32 (0x04)
+
+// Excitation signal with periodic licks.
+struct synthetic_trace_t
+{
+    double lick_rate_hz;
+    double lick_duration_ms;
+    uint16_t amplitude; // peak amplitude [ADC counts] when not licking.
+    uint8_t lick_depth_percent; // amplitude drop during a lick.
+    uint16_t noise; // peak uniform noise [ADC counts].
+};
+
+// General strategy:
+// Emulate the device's Harp interface over a file descriptor (i.e: the master
+// side of a pseudo-terminal). Requests are parsed and answered from register
+// structs laid out like the firmware's. Time is simulated: run_until()
+// synthesizes (or replays) one period of ADC samples at a time, feeds them to
+// the firmware's LickDetector, and emits a LickState event on every change.
+// Simulated time can run faster than real time to produce event rates well
+// beyond physical licking.
+
+class VirtualDevice
+{
+public:
+    VirtualDevice(int fd, const synthetic_trace_t& synthetic_trace);
+
+/**
+ * \brief replay \p samples (12-bit, sampled at ADC_SAMPLE_RATE_HZ) in a loop
+ *  instead of the synthetic trace.
+ */
+    void set_recorded_trace(const std::vector<uint16_t>& samples);
+
+/**
+ * \brief parse host requests and queue the replies.
+ */
+    void handle_input(const uint8_t* data, size_t size);
+
+/**
+ * \brief simulate every sample period up to \p time_us.
+ */
+    void run_until(uint64_t time_us);
+
+/**
+ * \brief write as much queued output to the file descriptor as it accepts.
+ * \return true if output is still pending.
+ */
+    bool flush_output();
+
+    inline uint64_t time_us() const {return time_us_;}
+    inline uint64_t event_count() const {return event_count_;}
+    inline uint64_t dropped_event_count() const {return dropped_event_count_;}
+    inline uint64_t request_count() const {return parser_.frame_count();}
+
+private:
+    struct reg_spec_t
+    {
+        uint8_t* data;
+        size_t size;
+        uint8_t payload_type;
+        bool writable;
+    };
+
+    void handle_request(const harp_frame_t& frame);
+    const reg_spec_t* find_reg(uint8_t address) const;
+    void apply_write(uint8_t address);
+    void apply_settings();
+    void fill_period();
+    uint64_t harp_time_us() const;
+    void send(uint8_t message_type, uint8_t address, const reg_spec_t* reg);
+
+    int fd_;
+    HarpFrameParser parser_;
+    std::vector<uint8_t> output_;
+    size_t output_offset_; // bytes of output_ already written.
+
+#pragma pack(push, 1)
+    struct core_regs_t
+    {
+        uint16_t who_am_i;
+        uint8_t hw_version_h;
+        uint8_t hw_version_l;
+        uint8_t assembly_version;
+        uint8_t harp_version_h;
+        uint8_t harp_version_l;
+        uint8_t fw_version_h;
+        uint8_t fw_version_l;
+        uint32_t timestamp_second;
+        uint16_t timestamp_micro;
+        uint8_t operation_ctrl;
+        uint8_t reset_def;
+        char device_name[25];
+        uint16_t serial_number;
+    } core_regs_;
+
+    // Same layout as the firmware's first app registers.
+    struct app_regs_t
+    {
+        uint8_t lick_state;
+        uint8_t on_threshold;
+        uint8_t off_threshold;
+        uint8_t settings;
+    } app_regs_;
+#pragma pack(pop)
+
+    reg_spec_t core_reg_specs_[14];
+    reg_spec_t app_reg_specs_[4];
+
+    int64_t harp_time_offset_us_; // harp time - simulated time.
+    uint64_t time_us_; // simulated time since boot.
+    uint32_t period_us_;
+    size_t samples_per_period_;
+
+    synthetic_trace_t synthetic_trace_;
+    int16_t sine_table_[VIRTUAL_DEVICE_MAX_SAMPLES_PER_PERIOD];
+    uint32_t noise_state_; // xorshift32 state.
+    std::vector<uint16_t> recorded_trace_;
+    size_t recorded_trace_index_;
+
+    uint16_t adc_vals_[VIRTUAL_DEVICE_MAX_SAMPLES_PER_PERIOD];
+    AmplitudeEstimator estimator_;
+    LickDetector lick_detector_;
+
+    uint64_t event_count_;
+    uint64_t dropped_event_count_;
+};
+
+#endif // VIRTUAL_DEVICE_H
@@ -0,0 +1,51 @@
+#include <host_shim.h>
+
+uint64_t host_time_us = 0;
+uint32_t host_gpio_outputs = 0;
+
+void host_set_time_us(uint64_t time_us)
+{
+    host_time_us = time_us;
+}
+
+void host_advance_time_us(uint64_t delta_us)
+{
+    host_time_us += delta_us;
+}
+
+uint32_t host_get_gpio_outputs()
+{
+    return host_gpio_outputs;
+}
+
+absolute_time_t get_absolute_time()
+{
+    return host_time_us;
+}
+
+uint64_t time_us_64()
+{
+    return host_time_us;
+}
+
+void gpio_init(uint gpio)
+{
+    host_gpio_outputs &= ~(1u << gpio);
+}
+
+void gpio_set_dir(uint, bool){}
+
+void gpio_put(uint gpio, bool value)
+{
+    gpio_put_masked(1u << gpio, uint32_t(value) << gpio);
+}
+
+bool gpio_get(uint gpio)
+{
+    return (host_gpio_outputs >> gpio) & 0x01;
+}
+
+void gpio_put_masked(uint32_t mask, uint32_t value)
+{
+    host_gpio_outputs = (host_gpio_outputs & ~mask) | (value & mask);
+}
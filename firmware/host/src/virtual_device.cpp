@@ -0,0 +1,282 @@
+#include <virtual_device.h>
+#include <host_shim.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+VirtualDevice::VirtualDevice(int fd, const synthetic_trace_t& synthetic_trace)
+:fd_{fd}, output_offset_{0},
+ harp_time_offset_us_{0}, time_us_{0},
+ synthetic_trace_{synthetic_trace}, noise_state_{0x12345678},
+ recorded_trace_index_{0},
+ adc_vals_{},
+ estimator_{adc_vals_, SAMPLES_PER_PERIOD},
+ lick_detector_{estimator_, NO_PIN, NO_PIN},
+ event_count_{0}, dropped_event_count_{0}
+{
+    output_.reserve(VIRTUAL_DEVICE_OUTPUT_LIMIT);
+    memset(&core_regs_, 0, sizeof(core_regs_));
+    core_regs_.who_am_i = HARP_DEVICE_ID;
+    core_regs_.hw_version_h = HW_VERSION_MAJOR;
+    core_regs_.hw_version_l = HW_VERSION_MINOR;
+    core_regs_.harp_version_h = 2;
+    core_regs_.fw_version_h = FW_VERSION_MAJOR;
+    core_regs_.fw_version_l = FW_VERSION_MINOR;
+    core_regs_.operation_ctrl = 0x01; // Active, so events flow immediately.
+    strncpy(core_regs_.device_name, "Lickety Split (virtual)",
+            sizeof(core_regs_.device_name));
+    core_reg_specs_[0] = {(uint8_t*)&core_regs_.who_am_i, 2, HARP_U16, false};
+    core_reg_specs_[1] = {&core_regs_.hw_version_h, 1, HARP_U8, false};
+    core_reg_specs_[2] = {&core_regs_.hw_version_l, 1, HARP_U8, false};
+    core_reg_specs_[3] = {&core_regs_.assembly_version, 1, HARP_U8, false};
+    core_reg_specs_[4] = {&core_regs_.harp_version_h, 1, HARP_U8, false};
+    core_reg_specs_[5] = {&core_regs_.harp_version_l, 1, HARP_U8, false};
+    core_reg_specs_[6] = {&core_regs_.fw_version_h, 1, HARP_U8, false};
+    core_reg_specs_[7] = {&core_regs_.fw_version_l, 1, HARP_U8, false};
+    core_reg_specs_[8] = {(uint8_t*)&core_regs_.timestamp_second, 4, HARP_U32,
+                          true};
+    core_reg_specs_[9] = {(uint8_t*)&core_regs_.timestamp_micro, 2, HARP_U16,
+                          false};
+    core_reg_specs_[10] = {&core_regs_.operation_ctrl, 1, HARP_U8, true};
+    core_reg_specs_[11] = {&core_regs_.reset_def, 1, HARP_U8, true};
+    core_reg_specs_[12] = {(uint8_t*)core_regs_.device_name,
+                           sizeof(core_regs_.device_name), HARP_U8, false};
+    core_reg_specs_[13] = {(uint8_t*)&core_regs_.serial_number, 2, HARP_U16,
+                           false};
+    app_regs_.lick_state = 0;
+    app_regs_.on_threshold = DEFAULT_ON_THRESHOLD_PERCENT;
+    app_regs_.off_threshold = DEFAULT_OFF_THRESHOLD_PERCENT;
+    app_regs_.settings = 0x01; // 100KHz, 2Vpp.
+    app_reg_specs_[0] = {&app_regs_.lick_state, 1, HARP_U8, false};
+    app_reg_specs_[1] = {&app_regs_.on_threshold, 1, HARP_U8, true};
+    app_reg_specs_[2] = {&app_regs_.off_threshold, 1, HARP_U8, true};
+    app_reg_specs_[3] = {&app_regs_.settings, 1, HARP_U8, true};
+    apply_settings();
+}
+
+void VirtualDevice::set_recorded_trace(const std::vector<uint16_t>& samples)
+{
+    recorded_trace_ = samples;
+    recorded_trace_index_ = 0;
+}
+
+void VirtualDevice::handle_input(const uint8_t* data, size_t size)
+{
+    parser_.feed(data, size, [this](const harp_frame_t& frame)
+                             {handle_request(frame);});
+}
+
+const VirtualDevice::reg_spec_t* VirtualDevice::find_reg(uint8_t address) const
+{
+    if (address < count_of(core_reg_specs_))
+        return &core_reg_specs_[address];
+    if (address >= 32 && address < 32 + count_of(app_reg_specs_))
+        return &app_reg_specs_[address - 32];
+    return nullptr;
+}
+
+void VirtualDevice::handle_request(const harp_frame_t& frame)
+{
+    const reg_spec_t* reg = find_reg(frame.address);
+    if (frame.message_type == HARP_READ)
+    {
+        if (reg == nullptr)
+        {
+            send(HARP_READ_ERROR, frame.address, nullptr);
+            return;
+        }
+        if (frame.address == 8 || frame.address == 9) // Timestamp registers.
+        {
+            uint64_t harp_time_us = this->harp_time_us();
+            core_regs_.timestamp_second = harp_time_us / 1000000;
+            core_regs_.timestamp_micro = (harp_time_us % 1000000)
+                                         / HARP_TIMESTAMP_TICK_US;
+        }
+        send(HARP_READ, frame.address, reg);
+    }
+    else if (frame.message_type == HARP_WRITE)
+    {
+        if (reg == nullptr || !reg->writable
+            || frame.payload_type != reg->payload_type
+            || frame.payload_size != reg->size)
+        {
+            send(HARP_WRITE_ERROR, frame.address, reg);
+            return;
+        }
+        memcpy(reg->data, frame.payload, reg->size);
+        apply_write(frame.address);
+        send(HARP_WRITE, frame.address, reg);
+    }
+}
+
+void VirtualDevice::apply_write(uint8_t address)
+{
+    switch (address)
+    {
+        case 8: // Harp time seconds. Restarts the subseconds at 0.
+        {
+            harp_time_offset_us_ = int64_t(core_regs_.timestamp_second)
+                                   * 1000000 - int64_t(time_us_);
+            break;
+        }
+        case 33:
+        {
+            lick_detector_.set_on_threshold_q16(
+                PERCENT_TO_Q16(app_regs_.on_threshold));
+            break;
+        }
+        case 34:
+        {
+            lick_detector_.set_off_threshold_q16(
+                PERCENT_TO_Q16(app_regs_.off_threshold));
+            break;
+        }
+        case 35:
+        {
+            apply_settings();
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void VirtualDevice::apply_settings()
+{
+    // Same choice as the firmware: 100KHz (20 samples) or 125KHz (16 samples).
+    samples_per_period_ = bool(app_regs_.settings & 0x01)? 20: 16;
+    period_us_ = (1000000ul * samples_per_period_) / ADC_SAMPLE_RATE_HZ;
+    for (size_t i = 0; i < samples_per_period_; ++i)
+        sine_table_[i] = int16_t(lround(sin(2 * M_PI * i / samples_per_period_)
+                                        * 32767));
+    lick_detector_.reset();
+    estimator_.set_samples_per_period(samples_per_period_);
+    lick_detector_.set_period_ns(period_us_ * 1000);
+}
+
+void VirtualDevice::fill_period()
+{
+    if (!recorded_trace_.empty())
+    {
+        for (size_t i = 0; i < samples_per_period_; ++i)
+        {
+            adc_vals_[i] = recorded_trace_[recorded_trace_index_++];
+            if (recorded_trace_index_ == recorded_trace_.size())
+                recorded_trace_index_ = 0;
+        }
+        return;
+    }
+    // Lick for lick_duration_ms at the start of every lick interval.
+    uint64_t lick_interval_us = 1e6 / synthetic_trace_.lick_rate_hz;
+    uint64_t lick_duration_us = synthetic_trace_.lick_duration_ms * 1e3;
+    bool licking = (time_us_ > lick_interval_us) // Let the filters warm up.
+                   && ((time_us_ % lick_interval_us) < lick_duration_us);
+    int32_t amplitude = synthetic_trace_.amplitude;
+    if (licking)
+        amplitude -= (amplitude * synthetic_trace_.lick_depth_percent) / 100;
+    for (size_t i = 0; i < samples_per_period_; ++i)
+    {
+        int32_t noise = 0;
+        if (synthetic_trace_.noise)
+        {
+            noise_state_ ^= noise_state_ << 13;
+            noise_state_ ^= noise_state_ >> 17;
+            noise_state_ ^= noise_state_ << 5;
+            noise = int32_t(noise_state_ % (2u * synthetic_trace_.noise + 1))
+                    - synthetic_trace_.noise;
+        }
+        int32_t sample = VIRTUAL_DEVICE_ADC_MIDSCALE
+                         + ((amplitude * sine_table_[i]) >> 15) + noise;
+        adc_vals_[i] = (sample < 0)? 0: (sample > 4095)? 4095: sample;
+    }
+}
+
+void VirtualDevice::run_until(uint64_t time_us)
+{
+    while (time_us_ + period_us_ <= time_us)
+    {
+        time_us_ += period_us_;
+        host_set_time_us(time_us_);
+        fill_period();
+        estimator_.update();
+        lick_detector_.update();
+        uint8_t lick_state = app_regs_.lick_state;
+        if (lick_detector_.lick_start_detected())
+        {
+            lick_detector_.clear_lick_detection_start_flag();
+            lick_state = 0x01;
+        }
+        else if (lick_detector_.lick_stop_detected())
+        {
+            lick_detector_.clear_lick_detection_stop_flag();
+            lick_state = 0x00;
+        }
+        if (lick_state == app_regs_.lick_state)
+            continue;
+        app_regs_.lick_state = lick_state;
+        if ((core_regs_.operation_ctrl & 0x03) != 0x01) // Not Active.
+            continue;
+        if (output_.size() - output_offset_ > VIRTUAL_DEVICE_OUTPUT_LIMIT)
+        {
+            ++dropped_event_count_;
+            continue;
+        }
+        send(HARP_EVENT, 32, &app_reg_specs_[0]);
+        ++event_count_;
+    }
+}
+
+uint64_t VirtualDevice::harp_time_us() const
+{
+    return uint64_t(int64_t(time_us_) + harp_time_offset_us_);
+}
+
+void VirtualDevice::send(uint8_t message_type, uint8_t address,
+                         const reg_spec_t* reg)
+{
+    uint64_t harp_time_us = this->harp_time_us();
+    uint32_t seconds = harp_time_us / 1000000;
+    uint16_t ticks = (harp_time_us % 1000000) / HARP_TIMESTAMP_TICK_US;
+    size_t payload_size = reg? reg->size: 0;
+    uint8_t payload_type = reg? reg->payload_type: HARP_U8;
+    // Address, port, payload type, timestamp, payload, checksum.
+    uint8_t length = 3 + 6 + payload_size + 1;
+    size_t start = output_.size();
+    output_.insert(output_.end(),
+                   {message_type, length, address, 255,
+                    uint8_t(payload_type | HARP_HAS_TIMESTAMP),
+                    uint8_t(seconds), uint8_t(seconds >> 8),
+                    uint8_t(seconds >> 16), uint8_t(seconds >> 24),
+                    uint8_t(ticks), uint8_t(ticks >> 8)});
+    if (payload_size)
+        output_.insert(output_.end(), reg->data, reg->data + payload_size);
+    uint8_t checksum = 0;
+    for (size_t i = start; i < output_.size(); ++i)
+        checksum += output_[i];
+    output_.push_back(checksum);
+}
+
+bool VirtualDevice::flush_output()
+{
+    while (output_offset_ < output_.size())
+    {
+        ssize_t written = write(fd_, output_.data() + output_offset_,
+                                output_.size() - output_offset_);
+        if (written <= 0)
+            break; // EAGAIN: the host is not keeping up.
+        output_offset_ += written;
+    }
+    if (output_offset_ == output_.size())
+    {
+        output_.clear();
+        output_offset_ = 0;
+    }
+    else if (output_offset_ > VIRTUAL_DEVICE_OUTPUT_LIMIT / 2)
+    {
+        // Reclaim the written part without reallocating.
+        output_.erase(output_.begin(), output_.begin() + output_offset_);
+        output_offset_ = 0;
+    }
+    return output_offset_ < output_.size();
+}
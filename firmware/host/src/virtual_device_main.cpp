@@ -0,0 +1,161 @@
+#include <virtual_device.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Emulates a Lickety Split over a pseudo-terminal so that host software can be
+// tested (and load-tested) without hardware. Connect to the printed port like
+// a real device.
+
+namespace
+{
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int)
+{
+    stop_requested = 1;
+}
+
+uint64_t monotonic_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+void print_usage(const char* name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --lick-rate HZ       licks per (simulated) second. Default: 5\n"
+        "  --lick-duration MS   duration of each lick. Default: 50\n"
+        "  --depth PERCENT      amplitude drop during a lick. Default: 50\n"
+        "  --noise COUNTS       peak uniform noise. Default: 20\n"
+        "  --speed X            simulated time per real time. Default: 1\n"
+        "  --trace FILE         replay raw little-endian uint16 ADC samples\n"
+        "                       (2MHz) instead of synthesizing licks.\n"
+        "  --link PATH          also make the port available at PATH.\n",
+        name);
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    synthetic_trace_t synthetic_trace{5, 50, 1000, 50, 20};
+    double speed = 1;
+    const char* trace_path = nullptr;
+    const char* link_path = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* value = (i + 1 < argc)? argv[i + 1]: nullptr;
+        if (value == nullptr)
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (!strcmp(argv[i], "--lick-rate"))
+            synthetic_trace.lick_rate_hz = atof(value);
+        else if (!strcmp(argv[i], "--lick-duration"))
+            synthetic_trace.lick_duration_ms = atof(value);
+        else if (!strcmp(argv[i], "--depth"))
+            synthetic_trace.lick_depth_percent = atoi(value);
+        else if (!strcmp(argv[i], "--noise"))
+            synthetic_trace.noise = atoi(value);
+        else if (!strcmp(argv[i], "--speed"))
+            speed = atof(value);
+        else if (!strcmp(argv[i], "--trace"))
+            trace_path = value;
+        else if (!strcmp(argv[i], "--link"))
+            link_path = value;
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        ++i;
+    }
+    if (synthetic_trace.lick_rate_hz <= 0 || speed <= 0)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd < 0 || grantpt(master_fd) || unlockpt(master_fd))
+    {
+        perror("Cannot create a pseudo-terminal");
+        return 1;
+    }
+    fcntl(master_fd, F_SETFL, O_NONBLOCK);
+    const char* port = ptsname(master_fd);
+    // Hold the port open so that the master never sees a hangup between
+    // clients, and make it raw like a USB CDC port.
+    int port_fd = open(port, O_RDWR | O_NOCTTY);
+    struct termios tty;
+    tcgetattr(port_fd, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(port_fd, TCSANOW, &tty);
+    if (link_path)
+    {
+        unlink(link_path);
+        if (symlink(port, link_path))
+            perror("Cannot create link");
+    }
+
+    VirtualDevice device(master_fd, synthetic_trace);
+    if (trace_path)
+    {
+        FILE* trace_file = fopen(trace_path, "rb");
+        if (trace_file == nullptr)
+        {
+            perror(trace_path);
+            return 1;
+        }
+        std::vector<uint16_t> samples;
+        uint16_t sample;
+        while (fread(&sample, sizeof(sample), 1, trace_file) == 1)
+            samples.push_back(sample & 0x0FFF);
+        fclose(trace_file);
+        if (samples.empty())
+        {
+            fprintf(stderr, "%s has no samples.\n", trace_path);
+            return 1;
+        }
+        device.set_recorded_trace(samples);
+    }
+    printf("Virtual Lickety Split on %s\n", link_path? link_path: port);
+    fflush(stdout);
+    signal(SIGINT, request_stop);
+    signal(SIGTERM, request_stop);
+
+    uint8_t chunk[4096];
+    struct pollfd poll_fd{master_fd, POLLIN, 0};
+    uint64_t start_us = monotonic_us();
+    while (!stop_requested)
+    {
+        poll(&poll_fd, 1, 1); // Wake at least once per ms to simulate.
+        ssize_t size;
+        while ((size = read(master_fd, chunk, sizeof(chunk))) > 0)
+            device.handle_input(chunk, size);
+        device.run_until((monotonic_us() - start_us) * speed);
+        poll_fd.events = device.flush_output()? POLLIN | POLLOUT: POLLIN;
+    }
+    if (link_path)
+        unlink(link_path);
+    close(port_fd);
+    close(master_fd);
+    fprintf(stderr, "%llu events sent, %llu dropped, %llu requests "
+                    "answered over %.3f simulated seconds.\n",
+            (unsigned long long)device.event_count(),
+            (unsigned long long)device.dropped_event_count(),
+            (unsigned long long)device.request_count(),
+            device.time_us() / 1e6);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <lick_detector.h>
+#include <config.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Times the per-period work on the host: the raw amplitude measurement alone,
+// then a full estimator and detector update.
+// Host timings only rank changes against each other. They say nothing
+// absolute about the RP2040 (see tools/cycle_budget.py for that).
+// Usage: lick_detector_benchmark [periods]
+
+namespace
+{
+uint16_t adc_vals[SAMPLES_PER_PERIOD];
+
+double ns_per_period(std::chrono::steady_clock::duration elapsed,
+                     long periods)
+{
+    return std::chrono::duration<double, std::nano>(elapsed).count() / periods;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    long periods = (argc > 1)? atol(argv[1]): 10000000;
+    if (periods < 1)
+    {
+        fprintf(stderr, "Usage: %s [periods]\n", argv[0]);
+        return 1;
+    }
+    for (size_t i = 0; i < SAMPLES_PER_PERIOD; ++i)
+        adc_vals[i] = 2048 + lround(500 * sin(2 * M_PI * i
+                                               / SAMPLES_PER_PERIOD));
+    AmplitudeEstimator estimator(adc_vals, SAMPLES_PER_PERIOD);
+    LickDetector detector(estimator, NO_PIN, NO_PIN);
+
+    volatile uint32_t sink = 0; // Keep the measurements from being optimized
+                                // out.
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < periods; ++i)
+    {
+        // Vary one sample so the compiler cannot hoist the loop body.
+        adc_vals[i % SAMPLES_PER_PERIOD] ^= 1;
+        sink = estimator.get_raw_amplitude();
+    }
+    auto raw_elapsed = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < periods; ++i)
+    {
+        adc_vals[i % SAMPLES_PER_PERIOD] ^= 1;
+        estimator.update();
+        detector.update();
+        sink = estimator.upscaled_amplitude_avg();
+    }
+    auto update_elapsed = std::chrono::steady_clock::now() - start;
+    (void)sink;
+
+    printf("periods:                          %ld\n", periods);
+    printf("get_raw_amplitude():              %.1f ns/period\n",
+           ns_per_period(raw_elapsed, periods));
+    printf("estimator + detector update():    %.1f ns/period\n",
+           ns_per_period(update_elapsed, periods));
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include <host_shim.h>
+#include <lick_detector.h>
+#include <config.h>
+#include <math.h>
+#include <random>
+#include <test_check.h>
+
+// Walks a LickDetector through RESET, WARMUP, UNTRIGGERED, TRIGGERED, and
+// back to UNTRIGGERED with a synthetic waveform, checking the transitions,
+// the outputs, and the hold time against the shim's simulated clock. Then
+// checks the onset latency of the CUSUM mode and of decimated detectors,
+// and the ZSCORE mode's running statistics.
+
+namespace
+{
+const uint32_t OUTPUT_MASK = (1u << TTL_PIN) | (1u << LED_PIN);
+const uint64_t PERIOD_US = (SAMPLES_PER_PERIOD * 1000000ull)
+                           / ADC_SAMPLE_RATE_HZ;
+const uint32_t BASELINE_AMPLITUDE = 1000;
+const uint32_t CONTACT_AMPLITUDE = 500;
+
+uint16_t adc_vals[SAMPLES_PER_PERIOD];
+
+void fill_period(uint32_t amplitude)
+{
+    for (size_t i = 0; i < SAMPLES_PER_PERIOD; ++i)
+        adc_vals[i] = 2048 + lround(0.5 * amplitude
+                                    * sin(2 * M_PI * i / SAMPLES_PER_PERIOD));
+}
+
+// One period of samples arrives, then core1 processes it.
+void step(AmplitudeEstimator& estimator, LickDetector& detector,
+          uint32_t amplitude)
+{
+    fill_period(amplitude);
+    host_advance_time_us(PERIOD_US);
+    estimator.update();
+    detector.update();
+}
+
+// Step until the detector reaches \p state.
+// Returns the number of periods it took, or -1 if it never did.
+long step_until(AmplitudeEstimator& estimator, LickDetector& detector,
+                uint32_t amplitude, LickDetector::State state,
+                long max_periods)
+{
+    for (long periods = 1; periods <= max_periods; ++periods)
+    {
+        step(estimator, detector, amplitude);
+        if (detector.state() == state)
+            return periods;
+    }
+    return -1;
+}
+
+// One period with decimation, the way core1_main() runs it: on periods that
+// may be skipped, an idle estimator skips the period, and its detectors with
+// it.
+void step_decimated(AmplitudeEstimator& estimator, LickDetector& detector,
+                    uint32_t amplitude, bool may_skip)
+{
+    fill_period(amplitude);
+    host_advance_time_us(PERIOD_US);
+    if (may_skip && estimator.idle())
+        estimator.skip();
+    else
+        estimator.update();
+    if (!estimator.skipped())
+        detector.update();
+}
+
+// Periods from the start of a contact until the detector triggers, with idle
+// periods decimated by \p factor. The contact starts \p phase periods into a
+// decimation cycle and falls from the baseline to CONTACT_AMPLITUDE by
+// \p fall_per_period every period.
+// Counts the periods that were skipped before the contact in \p skipped.
+long decimated_onset_periods(uint8_t factor, uint8_t phase,
+                             uint32_t fall_per_period, long& skipped)
+{
+    const long hold_periods = LICK_HOLD_TIME_US / PERIOD_US;
+    host_set_time_us(0);
+    AmplitudeEstimator estimator(adc_vals, SAMPLES_PER_PERIOD);
+    LickDetector detector(estimator, TTL_PIN, LED_PIN);
+    long period = 0;
+    skipped = 0;
+    for (; period < 2 * hold_periods + phase; ++period)
+    {
+        step_decimated(estimator, detector, BASELINE_AMPLITUDE,
+                       period % factor);
+        skipped += estimator.skipped();
+    }
+    CHECK(detector.state() == LickDetector::UNTRIGGERED);
+    uint32_t amplitude = BASELINE_AMPLITUDE;
+    for (long periods = 1; periods <= 2 * hold_periods; ++periods, ++period)
+    {
+        amplitude = (amplitude > CONTACT_AMPLITUDE + fall_per_period)?
+                    amplitude - fall_per_period: CONTACT_AMPLITUDE;
+        step_decimated(estimator, detector, amplitude, period % factor);
+        if (detector.state() == LickDetector::TRIGGERED)
+            return periods;
+    }
+    return -1;
+}
+
+void test_state_transitions()
+{
+    const long hold_periods = LICK_HOLD_TIME_US / PERIOD_US;
+    host_set_time_us(0);
+    AmplitudeEstimator estimator(adc_vals, SAMPLES_PER_PERIOD);
+    LickDetector detector(estimator, TTL_PIN, LED_PIN); // board pins.
+    CHECK(detector.state() == LickDetector::RESET);
+    CHECK((host_get_gpio_outputs() & OUTPUT_MASK) == 0);
+
+    // RESET lasts one period.
+    step(estimator, detector, BASELINE_AMPLITUDE);
+    CHECK(detector.state() == LickDetector::WARMUP);
+
+    // WARMUP lasts until the filters have settled.
+    long periods = step_until(estimator, detector, BASELINE_AMPLITUDE,
+                              LickDetector::UNTRIGGERED,
+                              2 * FILTER_WARMUP_ITERATION_COUNT);
+    CHECK(periods == FILTER_WARMUP_ITERATION_COUNT + 1);
+
+    // No contact, no trigger. Run past the hold time from the reset.
+    periods = step_until(estimator, detector, BASELINE_AMPLITUDE,
+                         LickDetector::TRIGGERED, 2 * hold_periods);
+    CHECK(periods == -1);
+    CHECK(!detector.lick_start_detected());
+
+    // A contact triggers once the whole consensus window agrees. The moving
+    // average needs a period to cross the on-threshold.
+    uint64_t contact_time_us = time_us_64();
+    periods = step_until(estimator, detector, CONTACT_AMPLITUDE,
+                         LickDetector::TRIGGERED, 4 * CONSENSUS_WINDOW);
+    CHECK(periods >= long(CONSENSUS_WINDOW));
+    CHECK(periods <= long(CONSENSUS_WINDOW) + 2);
+    CHECK(time_us_64() - contact_time_us == periods * PERIOD_US);
+    CHECK(detector.lick_start_detected());
+    CHECK((host_get_gpio_outputs() & OUTPUT_MASK) == OUTPUT_MASK);
+    detector.clear_lick_detection_start_flag();
+
+    // A contact shorter than the hold time stays asserted for the hold time.
+    uint64_t trigger_time_us = time_us_64();
+    periods = step_until(estimator, detector, BASELINE_AMPLITUDE,
+                         LickDetector::UNTRIGGERED, 2 * hold_periods);
+    CHECK(periods > hold_periods);
+    CHECK(periods <= hold_periods + 2);
+    CHECK(time_us_64() - trigger_time_us > LICK_HOLD_TIME_US);
+    CHECK(detector.lick_stop_detected());
+    CHECK(detector.contact_features_.duration_periods == uint32_t(periods));
+    CHECK((host_get_gpio_outputs() & OUTPUT_MASK) == 0);
+    detector.clear_lick_detection_stop_flag();
+
+    // The next contact cannot trigger until the hold time has elapsed since
+    // the last one ended.
+    uint64_t release_time_us = time_us_64();
+    periods = step_until(estimator, detector, CONTACT_AMPLITUDE,
+                         LickDetector::TRIGGERED, 2 * hold_periods);
+    CHECK(periods > hold_periods);
+    CHECK(time_us_64() - release_time_us > LICK_HOLD_TIME_US);
+    CHECK(detector.lick_start_detected());
+
+    // A reset drops the outputs and starts over.
+    detector.reset();
+    step(estimator, detector, BASELINE_AMPLITUDE);
+    CHECK(detector.state() == LickDetector::WARMUP);
+    CHECK((host_get_gpio_outputs() & OUTPUT_MASK) == 0);
+}
+
+void test_long_contact()
+{
+    // A contact longer than the hold time releases as soon as the consensus
+    // window has cleared. The moving average needs a few periods to climb
+    // back above the off-threshold.
+    const long hold_periods = LICK_HOLD_TIME_US / PERIOD_US;
+    host_set_time_us(0);
+    AmplitudeEstimator estimator(adc_vals, SAMPLES_PER_PERIOD);
+    LickDetector detector(estimator, TTL_PIN, LED_PIN);
+    step_until(estimator, detector, BASELINE_AMPLITUDE,
+               LickDetector::TRIGGERED, 2 * hold_periods);
+    long periods = step_until(estimator, detector, CONTACT_AMPLITUDE,
+                              LickDetector::TRIGGERED, 4 * CONSENSUS_WINDOW);
+    CHECK(periods > 0);
+    periods = step_until(estimator, detector, CONTACT_AMPLITUDE,
+                         LickDetector::UNTRIGGERED, 3 * hold_periods);
+    CHECK(periods == -1);
+    periods = step_until(estimator, detector, BASELINE_AMPLITUDE,
+                         LickDetector::UNTRIGGERED, 4 * CONSENSUS_WINDOW);
+    CHECK(periods >= long(CONSENSUS_WINDOW));
+    CHECK(periods <= long(CONSENSUS_WINDOW) + 8);
+    CHECK(detector.lick_stop_detected());
+}
+
+void test_cusum_latency()
+{
+    // CUSUM triggers once the accumulated deficit, less the drift, exceeds
+    // the limit: limit/(deficit - drift) periods into a contact, plus one for
+    // the moving average to settle. A dip shallower than the drift never
+    // accumulates. Each contact starts from a fresh detector so that no
+    // baseline update lands in it.
+    const long hold_periods = LICK_HOLD_TIME_US / PERIOD_US;
+    const uint32_t dip_amplitude = BASELINE_AMPLITUDE * 97 / 100;
+    // The dip, then contacts right at the on-threshold, shallow, and deep.
+    const uint32_t amplitudes[] = {
+        dip_amplitude,
+        BASELINE_AMPLITUDE * DEFAULT_ON_THRESHOLD_PERCENT / 100,
+        BASELINE_AMPLITUDE * 85 / 100,
+        CONTACT_AMPLITUDE};
+    long periods = -1;
+    for (uint32_t amplitude : amplitudes)
+    {
+        host_set_time_us(0);
+        AmplitudeEstimator estimator(adc_vals, SAMPLES_PER_PERIOD);
+        LickDetector detector(estimator, TTL_PIN, LED_PIN);
+        detector.set_detection_mode(LickDetector::CUSUM,
+                                    DEFAULT_CUSUM_THRESHOLD_Q4);
+        periods = step_until(estimator, detector, BASELINE_AMPLITUDE,
+                             LickDetector::TRIGGERED, 2 * hold_periods);
+        CHECK(periods == -1);
+
+        // The drift is half the on-threshold deficit, and the limit is
+        // DEFAULT_CUSUM_THRESHOLD_Q4/16 of them.
+        uint32_t baseline = estimator.upscaled_baseline_avg();
+        uint32_t on_deficit = baseline
+            - uint32_t((uint64_t(DEFAULT_ON_THRESHOLD_Q16) * baseline) >> 16);
+        CHECK(detector.cusum_drift() == on_deficit / 2);
+        CHECK(detector.cusum_limit()
+              == on_deficit * DEFAULT_CUSUM_THRESHOLD_Q4 / 16);
+
+        periods = step_until(estimator, detector, amplitude,
+                             LickDetector::TRIGGERED, 2 * hold_periods);
+        if (amplitude == dip_amplitude)
+        {
+            CHECK(periods == -1);
+            continue;
+        }
+        uint32_t increment = baseline - amplitude * UPSCALE_FACTOR
+                             - detector.cusum_drift();
+        long min_periods = detector.cusum_limit() / increment + 1;
+        CHECK(periods >= min_periods);
+        CHECK(periods <= min_periods + 1);
+        CHECK(detector.lick_start_detected());
+    }
+    // A deep contact beats the consensus window by far.
+    CHECK(periods <= 2);
+}
+void test_decimation_onset_latency()
+{
+    // A contact that takes longer than the decimation factor to fall from the
+    // guard to the on-threshold triggers on the same period as it does at
+    // full rate, whatever the decimation phase it starts in.
+    const uint8_t factor = 16;
+    const uint32_t guard_band = BASELINE_AMPLITUDE
+        * (DEFAULT_GUARD_PERCENT - DEFAULT_ON_THRESHOLD_PERCENT) / 100;
+    const uint32_t slow_fall = guard_band / (factor + 1);
+    long skipped;
+    long full_rate_periods = decimated_onset_periods(1, 0, slow_fall,
+                                                     skipped);
+    CHECK(full_rate_periods > 0);
+    CHECK(skipped == 0);
+    for (uint8_t phase = 0; phase < factor; ++phase)
+    {
+        long periods = decimated_onset_periods(factor, phase, slow_fall,
+                                               skipped);
+        CHECK(periods == full_rate_periods);
+        CHECK(skipped > 0);
+    }
+
+    // A step contact falls through the guard band between updates, so it is
+    // seen up to factor - 1 periods late.
+    const uint32_t step_fall = BASELINE_AMPLITUDE - CONTACT_AMPLITUDE;
+    full_rate_periods = decimated_onset_periods(1, 0, step_fall, skipped);
+    long max_periods = 0;
+    for (uint8_t phase = 0; phase < factor; ++phase)
+    {
+        long periods = decimated_onset_periods(factor, phase, step_fall,
+                                               skipped);
+        CHECK(periods >= full_rate_periods);
+        if (periods > max_periods)
+            max_periods = periods;
+    }
+    CHECK(max_periods == full_rate_periods + factor - 1);
+}
+
+void test_zscore_statistics()
+{
+    // The fixed-point Welford mean and variance of the filtered amplitude
+    // match a double-precision reference over the same periods, both before
+    // the count saturates and after, when old periods are forgotten. The
+    // amplitude varies uniformly by up to 2% of the baseline, well above the
+    // on-threshold, so every untriggered period is tracked. Its level steps
+    // up partway through, and again once the count has saturated, so the
+    // mean moves and the variance includes the steps. Steps down could drop
+    // periods below the z-score on-threshold, which are left out.
+    const long window = 1l << LOG2_ZSCORE_WINDOW;
+    const uint32_t noise_amplitude = BASELINE_AMPLITUDE / 50;
+    host_set_time_us(0);
+    AmplitudeEstimator estimator(adc_vals, SAMPLES_PER_PERIOD);
+    LickDetector detector(estimator, TTL_PIN, LED_PIN);
+    detector.set_detection_mode(LickDetector::ZSCORE,
+                                DEFAULT_CUSUM_THRESHOLD_Q4);
+    std::mt19937 noise(1);
+    long count = 0;
+    double mean = 0;
+    double variance = 0;
+    // The standard deviation is only recomputed on baseline updates, so check
+    // on the first one after each stretch.
+    const long checkpoints[] = {long(ZSCORE_MIN_PERIODS), window + 4096};
+    for (long checkpoint : checkpoints)
+    {
+        while (count < checkpoint || !estimator.baseline_updated())
+        {
+            bool tracked = detector.state() == LickDetector::UNTRIGGERED;
+            if (tracked && count < long(ZSCORE_MIN_PERIODS))
+            {
+                CHECK(detector.zscore_mean() == 0);
+                CHECK(detector.zscore_sigma() == 0);
+            }
+            uint32_t level = BASELINE_AMPLITUDE - noise_amplitude;
+            if (count >= long(ZSCORE_MIN_PERIODS) / 2)
+                level += noise_amplitude;
+            if (count >= window)
+                level += noise_amplitude;
+            uint32_t amplitude = level - noise_amplitude
+                                 + noise() % (2 * noise_amplitude + 1);
+            step(estimator, detector, amplitude);
+            CHECK(detector.state() != LickDetector::TRIGGERED);
+            if (!tracked)
+                continue;
+            double x = estimator.upscaled_amplitude_avg();
+            ++count;
+            // Welford's algorithm, with the count saturated at the window.
+            double n = (count < window)? count: window;
+            double deviation = x - mean;
+            mean += deviation / n;
+            variance += (deviation * (x - mean) - variance) / n;
+        }
+        double sigma = sqrt(variance);
+        // At least the noise's standard deviation (about 12 amplitude units),
+        // which the moving average divides by sqrt(3).
+        CHECK(sigma > 6 * UPSCALE_FACTOR);
+        CHECK(fabs(detector.zscore_mean() - mean) <= 1);
+        CHECK(fabs(detector.zscore_sigma() - sigma) <= 1);
+    }
+}
+} // namespace
+
+int test_failures = 0;
+
+int main()
+{
+    test_state_transitions();
+    test_long_contact();
+    test_cusum_latency();
+    test_decimation_onset_latency();
+    test_zscore_statistics();
+    return test_result();
+}
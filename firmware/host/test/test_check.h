@@ -0,0 +1,29 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <stdio.h>
+
+// Minimal check for the host tests. A failed check is printed and counted,
+// and the test keeps going so that one run reports every failure.
+// Return test_result() from main().
+
+extern int test_failures;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+        { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                   #condition); \
+            ++test_failures; \
+        } \
+    } while (0)
+
+inline int test_result()
+{
+    if (test_failures)
+        printf("%d check(s) failed.\n", test_failures);
+    return test_failures? 1: 0;
+}
+
+#endif // TEST_CHECK_H
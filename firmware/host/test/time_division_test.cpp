@@ -0,0 +1,210 @@
+#include <time_division.h>
+#include <test_check.h>
+
+// Checks the time division schedule: slot alignment to Harp time 0, slot
+// rollover, the guard time in sampling(), and resyncing when the Harp clock
+// jumps.
+
+namespace
+{
+const uint8_t SLOT_COUNT = 3;
+const uint32_t SLOT_US = 1000;
+const uint32_t PERIOD_US = 10;
+const uint64_t CYCLE_US = SLOT_COUNT * SLOT_US;
+
+// Slot that contains \p harp_time_us, computed from scratch.
+uint8_t expected_slot(uint64_t harp_time_us)
+{
+    return (harp_time_us / SLOT_US) % SLOT_COUNT;
+}
+
+void test_disabled()
+{
+    TimeDivision time_division;
+    for (uint8_t slot_count = 0; slot_count < 2; ++slot_count)
+    {
+        time_division.configure(slot_count, 0, SLOT_US);
+        CHECK(!time_division.enabled());
+        for (uint64_t t = 0; t < 2 * SLOT_US; t += PERIOD_US)
+        {
+            time_division.update(t);
+            CHECK(time_division.excitation_enabled());
+            CHECK(time_division.sampling(PERIOD_US));
+        }
+    }
+}
+
+void test_board_index_alignment()
+{
+    // Every board derives its slot from Harp time alone, so boards agree on
+    // the schedule without talking to each other.
+    TimeDivision boards[SLOT_COUNT];
+    for (uint8_t i = 0; i < SLOT_COUNT; ++i)
+        boards[i].configure(SLOT_COUNT, i, SLOT_US);
+    // Start from arbitrary times, including one far from Harp time 0.
+    const uint64_t start_times_us[] = {0, 1234, 1700000000000999ull};
+    for (uint64_t start_us : start_times_us)
+    {
+        for (uint64_t t = start_us; t < start_us + 3 * CYCLE_US; t += 7)
+        {
+            uint8_t exciting = 0;
+            for (uint8_t i = 0; i < SLOT_COUNT; ++i)
+            {
+                boards[i].update(t);
+                CHECK(boards[i].slot() == expected_slot(t));
+                exciting += boards[i].excitation_enabled();
+            }
+            CHECK(exciting == 1); // Exactly one board at a time.
+            CHECK(boards[expected_slot(t)].excitation_enabled());
+        }
+    }
+    // Board 0's slot starts at Harp time 0.
+    TimeDivision board;
+    board.configure(SLOT_COUNT, 0, SLOT_US);
+    board.update(0);
+    CHECK(board.slot() == 0);
+    CHECK(board.excitation_enabled());
+    board.update(SLOT_US - 1);
+    CHECK(board.slot() == 0);
+    board.update(SLOT_US);
+    CHECK(board.slot() == 1);
+    CHECK(!board.excitation_enabled());
+}
+
+void test_slot_rollover()
+{
+    // Step through several cycles one period at a time, so slots only ever
+    // advance incrementally.
+    TimeDivision time_division;
+    time_division.configure(SLOT_COUNT, 1, SLOT_US);
+    for (uint64_t t = 0; t < 4 * CYCLE_US; t += PERIOD_US)
+    {
+        time_division.update(t);
+        CHECK(time_division.slot() == expected_slot(t));
+    }
+    // The last slot rolls over to slot 0 at the cycle boundary.
+    time_division.update(CYCLE_US - 1);
+    CHECK(time_division.slot() == SLOT_COUNT - 1);
+    time_division.update(CYCLE_US);
+    CHECK(time_division.slot() == 0);
+    // Steps longer than a slot (but within a cycle) still land right.
+    for (uint64_t t = CYCLE_US; t < 5 * CYCLE_US; t += SLOT_US + 333)
+    {
+        time_division.update(t);
+        CHECK(time_division.slot() == expected_slot(t));
+    }
+}
+
+void test_sampling_guard()
+{
+    TimeDivision time_division;
+    time_division.configure(SLOT_COUNT, 1, SLOT_US);
+    const uint64_t slot_start_us = SLOT_US; // board 1's first slot.
+    // The period ending at an update must start at least the guard time
+    // after the slot starts.
+    const uint32_t first_us = TIME_DIVISION_GUARD_US + PERIOD_US;
+    time_division.update(slot_start_us + first_us - 1);
+    CHECK(time_division.excitation_enabled());
+    CHECK(!time_division.sampling(PERIOD_US));
+    time_division.update(slot_start_us + first_us);
+    CHECK(time_division.sampling(PERIOD_US));
+    // ...and end at least the guard time before the slot ends.
+    const uint32_t last_us = SLOT_US - TIME_DIVISION_GUARD_US;
+    time_division.update(slot_start_us + last_us);
+    CHECK(time_division.sampling(PERIOD_US));
+    time_division.update(slot_start_us + last_us + 1);
+    CHECK(!time_division.sampling(PERIOD_US));
+    CHECK(time_division.excitation_enabled());
+    // Longer periods need more settled time in the slot.
+    time_division.update(slot_start_us + first_us);
+    CHECK(!time_division.sampling(2 * PERIOD_US));
+    // Never in another board's slot.
+    time_division.update(slot_start_us + SLOT_US + SLOT_US / 2);
+    CHECK(!time_division.excitation_enabled());
+    CHECK(!time_division.sampling(PERIOD_US));
+    time_division.update(SLOT_US / 2);
+    CHECK(!time_division.sampling(PERIOD_US));
+}
+
+void test_resync_backwards()
+{
+    // The Harp clock is resynchronized to an earlier time.
+    TimeDivision time_division;
+    time_division.configure(SLOT_COUNT, 1, SLOT_US);
+    for (uint64_t t = 0; t <= 5500; t += PERIOD_US)
+        time_division.update(t);
+    CHECK(time_division.slot() == expected_slot(5500));
+    time_division.update(1500);
+    CHECK(time_division.slot() == 1);
+    CHECK(time_division.sampling(PERIOD_US));
+    // A step back within the same slot.
+    time_division.update(1400);
+    CHECK(time_division.slot() == 1);
+    time_division.update(999);
+    CHECK(time_division.slot() == 0);
+    CHECK(!time_division.sampling(PERIOD_US));
+    // Incremental updates carry on from the new time.
+    for (uint64_t t = 999; t < 999 + 2 * CYCLE_US; t += PERIOD_US)
+    {
+        time_division.update(t);
+        CHECK(time_division.slot() == expected_slot(t));
+    }
+}
+
+void test_resync_skip()
+{
+    // The Harp clock is resynchronized to a later time.
+    TimeDivision time_division;
+    time_division.configure(SLOT_COUNT, 1, SLOT_US);
+    time_division.update(500);
+    CHECK(time_division.slot() == 0);
+    // Exactly one cycle.
+    time_division.update(500 + CYCLE_US);
+    CHECK(time_division.slot() == 0);
+    // Many cycles and a fraction.
+    uint64_t t = 500 + CYCLE_US + 7 * CYCLE_US + 1250;
+    time_division.update(t);
+    CHECK(time_division.slot() == expected_slot(t));
+    CHECK(time_division.slot() == 1);
+    // Just under a cycle, which is tracked incrementally.
+    t += CYCLE_US - 1;
+    time_division.update(t);
+    CHECK(time_division.slot() == expected_slot(t));
+    // Offsets within the slot are right after a skip.
+    t = 100 * CYCLE_US + SLOT_US + TIME_DIVISION_GUARD_US + PERIOD_US;
+    time_division.update(t);
+    CHECK(time_division.slot() == 1);
+    CHECK(time_division.sampling(PERIOD_US));
+}
+
+void test_reconfigure()
+{
+    // Reconfiguring relocates the slot from scratch.
+    TimeDivision time_division;
+    time_division.configure(SLOT_COUNT, 1, SLOT_US);
+    time_division.update(5500);
+    time_division.configure(4, 1, 2 * SLOT_US);
+    time_division.update(5500);
+    CHECK(time_division.slot() == 2);
+    // Slots shorter than the minimum are lengthened.
+    time_division.configure(SLOT_COUNT, 0, TIME_DIVISION_MIN_SLOT_US / 2);
+    time_division.update(TIME_DIVISION_MIN_SLOT_US - 1);
+    CHECK(time_division.slot() == 0);
+    time_division.update(TIME_DIVISION_MIN_SLOT_US);
+    CHECK(time_division.slot() == 1);
+}
+} // namespace
+
+int test_failures = 0;
+
+int main()
+{
+    test_disabled();
+    test_board_index_alignment();
+    test_slot_rollover();
+    test_sampling_guard();
+    test_resync_backwards();
+    test_resync_skip();
+    test_reconfigure();
+    return test_result();
+}
@@ -5,7 +5,11 @@
 #include <pico/stdlib.h>
 #include <stdio.h>
 #include <hardware/spi.h>
+#include <hardware/dma.h>
 #include <math.h> // for atan.
+#include <core1_placement.h>
+
+#define AD9833_WRITE_QUEUE_SIZE (8) // max 16-bit words queued per DMA transfer.
 
 
 class AD9833
@@ -44,6 +48,27 @@ public:
 
     static void init_spi(spi_inst_t* spi);
 
+/**
+ * \brief hand chip select to the SPI peripheral and claim a DMA channel such
+ *  that all subsequent register writes are queued and sent without blocking.
+ * \note \p cs_pin must be the SPI peripheral's CSn pin. With CPHA=0, the
+ *  peripheral pulses CSn HIGH between 16-bit frames, which latches each word.
+ * \note queued writes are only launched from within a call to
+ *  \ref service(), so it must be called periodically.
+ */
+    void setup_dma_writes();
+
+/**
+ * \brief launch any queued register writes if the previous DMA transfer has
+ *  finished. Does not block.
+ */
+    void service();
+
+/**
+ * \brief true if there are register writes queued or still in flight.
+ */
+    bool writes_pending();
+
     void write_to_reg(RegName reg, uint16_t value);
 
 /**
@@ -77,18 +102,28 @@ public:
     void set_frequency_hz(uint32_t hz);
 
 /**
- * \brief set the phase as a floating point valve from 0-2pi.
+ * \brief set the phase as a floating point value in radians. Values outside
+ *  0-2pi are wrapped.
  */
     void set_phase(float offset);
 
 /**
- * \brief set the phase registers.
+ * \brief set the 12-bit phase register.
  */
     void set_phase_raw(uint32_t phase_bits);
 
 private:
     void spi_write16(uint16_t word);
 
+    // Double-buffered queue of words: one buffer is filled while the other
+    // is streamed to the SPI TX FIFO by DMA.
+    uint16_t write_queue_[2][AD9833_WRITE_QUEUE_SIZE];
+    size_t queued_words_;
+    uint8_t fill_index_; // index of the buffer being filled.
+    int dma_chan_; // -1 if writes are blocking.
+
+    uint16_t waveform_; // last waveform bits written to the control register.
+
     // bool tracking whether the device has been put into a reset state.
     bool device_is_reset_;
     // device input oscillator frequency.
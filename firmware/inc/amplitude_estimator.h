@@ -0,0 +1,158 @@
+#ifndef AMPLITUDE_ESTIMATOR_H
+#define AMPLITUDE_ESTIMATOR_H
+
+#include <tgmath.h>
+#include <pico/stdlib.h>
+#include <stdint.h>
+#include <core1_placement.h>
+
+#define BASELINE_SAMPLE_INTERVAL (3000ul) // number of periods between
+                                          // updating the baseline threshold.
+                                          // 100KHz/1000 periods = 100Hz update rate.
+#define UPSCALE_FACTOR (128) // Factor by which to multiply incoming
+#define MOVING_AVG_WINDOW (2ul) // This should be:
+                                 // a.) <=64 or the data will arrive late.
+                                 // b.) a power of 2.
+#define BASELINE_AVG_WINDOW (128)
+#define ADC_SAMPLE_RATE_HZ (2000000ul) // default rate at which adc_vals are
+                                       // sampled.
+
+// General strategy:
+// ADC writes a period's worth of 100KHz data (8-bit) sampled at 2MHz
+// continuously. Every waveform period (20 samples @ 500KHz), compute sampled
+// amplitude.
+// Push sampled amplitude into a moving average of the last MOVING_AVG_WINDOW
+// samples.
+// Every BASELINE_SAMPLE_INTERVAL samples, we update the baseline "no-lick"
+// measurement.
+// One estimator runs per channel, and any number of LickDetector threshold
+// state machines read from it, so the per-period cost of measuring the
+// amplitude and filtering it is only paid once per channel.
+
+// Note: average baseline and amplitude are upscaled by UPSCALE_FACTOR, so
+//  we don't lose precision while averaging them over time.
+
+// Note: timing is kept in units of periods (i.e: calls to update() or skip())
+//  rather than read from the system timer, so the timebase is the ADC sample
+//  clock.
+
+// Decimation:
+// Every state machine reading from the estimator calls require_full_rate()
+// from its update() unless it is idle. If none did, the caller may skip()
+// periods instead of update()ing them (and the state machines). skip() only
+// advances the timebase. The moving average restarts from the first period
+// update()d after a skip, so it never lags behind by the skipped periods.
+
+class AmplitudeEstimator
+{
+public:
+    AmplitudeEstimator(uint16_t* adc_vals, size_t samples_per_period);
+    ~AmplitudeEstimator();
+
+/**
+ * \brief reseed the filters with the next period's amplitude.
+ */
+    inline void reset()
+        {reset_ = true; full_rate_ = true;}
+
+/**
+ * \brief measure one period and update the filters.
+ */
+    void update();
+
+/**
+ * \brief advance the timebase by one period without measuring it.
+ */
+    inline void skip()
+    {
+        ++period_count_;
+        skipped_ = true;
+        // Leave the baseline update for the next update() if it is due.
+        if (sample_count_ < BASELINE_SAMPLE_INTERVAL)
+            ++sample_count_;
+    }
+
+    inline void set_samples_per_period(size_t samples_per_period)
+    {samples_per_period_ = samples_per_period;}
+
+    inline void set_adc_vals(uint16_t* adc_vals)
+    {adc_vals_ = adc_vals;}
+
+/**
+ * \brief compute the raw amplitude from one period of waveform samples.
+ * \note this is a naive implementation of max - min. A better implementation
+ *  would be the https://en.wikipedia.org/wiki/Goertzel_algorithm
+ */
+    uint32_t get_raw_amplitude();
+
+/**
+ * \brief keep this estimator updating every period. Cleared by update().
+ */
+    inline void require_full_rate()
+        {full_rate_ = true;}
+    inline bool idle()
+        {return !full_rate_;}
+    inline bool skipped()
+        {return skipped_;}
+
+/**
+ * \brief true if the filters were reseeded by the last update().
+ */
+    inline bool reseeded()
+        {return reseeded_;}
+/**
+ * \brief true if the baseline changed in the last update().
+ */
+    inline bool baseline_updated()
+        {return baseline_updated_;}
+
+/**
+ * \brief raw amplitude measured by the last update().
+ */
+    inline uint32_t raw_amplitude()
+        {return raw_amplitude_;}
+    inline uint32_t upscaled_amplitude_avg()
+        {return upscaled_amplitude_avg_;}
+    inline uint32_t upscaled_baseline_avg()
+        {return upscaled_baseline_avg_;}
+    inline uint32_t period_count()
+        {return period_count_;}
+
+private:
+/**
+ * \brief
+ */
+    inline void update_measurement_moving_avg();
+
+/**
+ * \brief
+ */
+    inline void update_baseline_moving_avg();
+
+    uint16_t* adc_vals_;
+    size_t samples_per_period_;
+
+#ifdef PROFILE_CPU
+public:
+#endif
+    uint32_t upscaled_baseline_avg_; // "baseline x scalar"
+    uint32_t upscaled_amplitude_avg_; // "setpoint x scalar"
+#ifdef PROFILE_CPU
+private:
+#endif
+    uint32_t raw_amplitude_;
+    uint32_t upscaled_amplitude_;
+    uint32_t log2_upscale_factor_;
+    uint32_t log2_baseline_window_;
+    uint32_t log2_moving_avg_window_;
+
+    size_t sample_count_;
+    uint32_t period_count_; // Timebase. Increments every update()/skip().
+
+    bool reset_;
+    bool reseeded_;
+    bool baseline_updated_;
+    bool full_rate_;
+    bool skipped_;
+};
+#endif // AMPLITUDE_ESTIMATOR_H
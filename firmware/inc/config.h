@@ -20,6 +20,17 @@
 #define SAMPLES_PER_PERIOD (20) // Samples per period of 100KHz signal when
                                 // sampled @ 2MHz.
 
+#define ADS7049_SM (0) // State machine the ADS7049 instance claims (the
+                       // first one on pio0).
+#define ADS7049_MIN_SAMPLE_RATE_HZ (10000ul)
+#define ADS7049_MAX_SAMPLE_RATE_HZ (2000000ul) // ADS7049 is rated to 2MSPS.
+#define ADS7049_MAX_SAMPLES_PER_PERIOD (256) // adc_vals capacity.
+#define ADS7049_MIN_SAMPLES_PER_PERIOD (2) // at least a min and a max.
+
+#define INTERNAL_ADC_PIN_MASK (0x01) // ADC0 (GPIO26) drives Channel1.
+#define INTERNAL_ADC_SAMPLES_PER_PERIOD (5) // Samples per period of 100KHz
+                                            // signal when sampled @ 500KHz.
+
 #define UART_TX_PIN (0)
 
 #define SQUARE_WAVE_PIN_100KHZ (2)
@@ -37,6 +48,7 @@
 #define AD9833_SPI_SCK_PIN (2)
 #define AD9833_SPI_TX_PIN (3)
 #define AD9833_SPI_RX_PIN (4)
+#define AD9833_MCLK_HZ (12000000ul) // Shared with the RP2040 oscillator.
 
 
 #define HARP_DEVICE_ID (0x0578)
@@ -12,7 +12,8 @@ extern "C" {
 #include <stdint.h>
 
 
-extern uint8_t adc_vals[];
+#define INTERNAL_ADC_SAMPLE_RATE_HZ (500000ul) // max rate (48MHz/96).
+
 extern int samp_chan; // The DMA channel for sampling. Must be exposed across
                       // files such that we can attach interrupts setup by this
                       // channel.
@@ -21,16 +22,36 @@ extern int samp_chan; // The DMA channel for sampling. Must be exposed across
  * \brief setup continuous adc sampling of the adc pins specified in the mask to
  *  the destination \p adc_samples_dest of length \p sample_count.
  * \param[in] adc_pin_mask a 5-bit value representing the adc pins to sample.
- * \param[in] adc_samples_dest a pointer to an 8-bit array in memory
+ * \param[in] adc_samples_dest a pointer to a 16-bit array in memory. Samples
+ *  are 12-bit, like the ADS7049's.
  * \param[in] sample_count the length of \p adc_samples_dest
  * \param[in] fire_interrupt if true, fire an interrupt upon completion of
  *  collecting \p sample_count samples.
  */
 void init_continuous_adc_sampling(uint8_t adc_pin_mask,
-                                  uint8_t* adc_samples_dest,
+                                  uint16_t* adc_samples_dest,
                                   uint8_t sample_count,
                                   bool fire_interrupt);
 
+/**
+ * \brief setup sampling of the adc pins specified in the mask, one transfer
+ *  of \p sample_count samples at a time. Each transfer starts when
+ *  trigger_adc_sampling() is called, so that it can be aligned with another
+ *  stream.
+ * \param[in] adc_pin_mask a 5-bit value representing the adc pins to sample.
+ * \param[in] sample_count the number of samples in each transfer.
+ */
+void init_triggered_adc_sampling(uint8_t adc_pin_mask, uint8_t sample_count);
+
+/**
+ * \brief discard samples converted so far and start a transfer of
+ *  \p sample_count samples to \p adc_samples_dest, aborting the previous
+ *  transfer if it is still running. Safe to call from an interrupt.
+ * \returns true if the previous transfer had finished, i.e: its destination
+ *  holds \p sample_count consecutive samples.
+ */
+bool trigger_adc_sampling(uint16_t* adc_samples_dest, uint8_t sample_count);
+
 #ifdef __cplusplus
 }
 #endif
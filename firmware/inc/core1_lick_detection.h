@@ -8,15 +8,66 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <hardware/irq.h>
+#include <hardware/pwm.h>
 #include <pio_ads7049.h>
 #include <lick_detector.h>
 #include <lick_queue.h>
 #include <config.h>
+#include <ad9833.h>
+#include <frequency_sweep.h>
+#include <continuous_adc.h>
+#include <ttl_output.h>
+#include <waveform_capture.h>
+#include <time_division.h>
+#include <core1_placement.h>
+
+// AD9833_EXCITATION compiler flag can be defined to generate the excitation
+// signal with the AD9833 function generator (hardware v0.5) instead of the
+// RP2040 PWM peripheral. This also enables frequency sweeps.
+
+// INTERNAL_ADC_CHANNEL compiler flag can be defined to run a second lick
+// detector (Channel1) from the RP2040's internal ADC alongside the ADS7049
+// stream. It is enabled at runtime through bit 2 of the settings register.
+
+// Channel0 also runs a proximity detector from the same amplitude estimate
+// as its touch detector. An approaching tongue or paw loads the electrode a
+// little, and for longer, than a contact does, so proximity uses shallower
+// thresholds with a longer consensus window and hold time. It is enabled at
+// runtime through bit 3 of the settings register.
+
+// Boards that share a rig can take turns exciting their electrodes in slots
+// of a schedule kept in Harp time (see time_division.h), so that their
+// excitation signals never couple into each other's measurements. Outside
+// of this board's slot, the excitation is off and every detector holds its
+// state. Configured at runtime through the TimeDivision registers.
 
 // PROFILE_CPU compiler flag can be defined to compute and dump
 // statistics to the serial port. Stats include (1) raw adc values, (2) how
 // many CPU cycles the update loop is taking.
 
+// The acquisition stream is considered stalled if no period interrupt arrives
+// within this many periods (or the minimum, whichever is longer).
+#define ACQUISITION_TIMEOUT_PERIODS (100)
+#define ACQUISITION_MIN_TIMEOUT_US (1000)
+
+// Channel0's CUSUM and decimation statistics are reported to core0 this often.
+#define DETECTOR_STATS_INTERVAL_PERIODS (100000ul) // 1s @ 100KHz.
+#define MAX_DECIMATION_FACTOR (16)
+
+// lick_states bit of each detector.
+#define CHANNEL0_STATE_BIT (0)
+#define CHANNEL1_STATE_BIT (1)
+#define PROXIMITY0_STATE_BIT (2)
+
+#define DEFAULT_PROXIMITY_ON_THRESHOLD_PERCENT (97)
+#define DEFAULT_PROXIMITY_OFF_THRESHOLD_PERCENT (99)
+#define DEFAULT_PROXIMITY_ON_THRESHOLD_Q16 \
+    (PERCENT_TO_Q16(DEFAULT_PROXIMITY_ON_THRESHOLD_PERCENT))
+#define DEFAULT_PROXIMITY_OFF_THRESHOLD_Q16 \
+    (PERCENT_TO_Q16(DEFAULT_PROXIMITY_OFF_THRESHOLD_PERCENT))
+#define PROXIMITY_CONSENSUS_WINDOW (CONSENSUS_WINDOW)
+#define PROXIMITY_HOLD_TIME_US (50000ul)
+
 #ifdef PROFILE_CPU
 #define PRINT_LOOP_INTERVAL_MS (16)
 
@@ -24,9 +75,9 @@
 #define SYST_CVR (*(volatile uint32_t*)(PPB_BASE + 0xe018))
 #endif
 
-//extern uint8_t adc_vals[];
-//extern int samp_chan; // DMA channel that collects ADC samples and triggers an
-//                      // interrupt.
+// Raw waveform ring. Written by core1. Core0 may only read the snapshot
+// after core1 reports it finished (and before arming it again).
+extern WaveformCapture waveform_capture;
 
 /**
  * \brief Interrupt handler. Connect to ad7049 DMA interrupt request to trigger
@@ -34,5 +85,62 @@
  */
 void flag_update();
 
+/**
+ * \brief restart the sample clock, which counts elapsed periods and is the
+ *  timebase for lick events. Call whenever the stream is (re)started.
+ */
+void reset_sample_clock(size_t samples_per_period, uint32_t sample_rate_hz);
+
+/**
+ * \brief change the ADS7049 sample rate by scaling the PIO clock divider that
+ *  the ADS7049 instance chose for ADC_SAMPLE_RATE_HZ.
+ * \return the actual sample rate, which is limited by the divider's 1/256
+ *  resolution.
+ */
+uint32_t set_ads7049_sample_rate(uint32_t sample_rate_hz);
+
+/**
+ * \brief read the 64-bit sample clock without tearing if the interrupt that
+ *  updates it fires mid-read.
+ */
+uint64_t get_sample_clock();
+
+/**
+ * \brief tear down and restart the ADS7049 stream with the latest sample rate
+ *  and samples per period. Restarts the sample clock.
+ */
+void restart_ads7049_stream();
+
+/**
+ * \brief copy the latest period into the noise-floor capture every
+ *  NOISE_CAPTURE_INTERVAL_PERIODS, and hand the capture to core0 once it
+ *  holds enough consecutive periods.
+ */
+void capture_noise_period();
+
+/**
+ * \brief freeze the raw waveform capture around the latest period, if armed.
+ */
+void trigger_waveform_capture();
+
+/**
+ * \brief turn the excitation signal on or off. Only writes to the hardware
+ *  on a change.
+ */
+void set_excitation(bool enabled);
+
+/**
+ * \brief recover from a stalled acquisition stream. Restarts the stream,
+ *  forces all lick detectors into a safe untriggered state, and notifies
+ *  core0 with the number of recoveries so far.
+ */
+void recover_acquisition();
+
+/**
+ * \brief apply any settings, thresholds, or requests that core0 published.
+ *  Only called when core0 rings core1_doorbell.
+ */
+void apply_core0_requests();
+
 void core1_main();
 #endif // CORE1_LICK_DETECTION_H
@@ -0,0 +1,22 @@
+#ifndef CORE1_PLACEMENT_H
+#define CORE1_PLACEMENT_H
+
+#include <pico/stdlib.h>
+
+// CORE1_IN_SRAM compiler flag can be defined to run core1's lick detection
+// hot path from SRAM instead of from flash through the XIP cache (which core0
+// also uses), and to keep its data in the SCRATCH_X bank, which core1's stack
+// otherwise has to itself. A report of where each symbol landed is generated
+// with every build, and fails the build if core1's data leaves too little of
+// SCRATCH_X for its stack. See the "Core1 Memory Placement" section of the
+// README.
+
+#if defined(CORE1_IN_SRAM)
+#define __core1_func(func_name) __not_in_flash_func(func_name)
+#define __core1_data(group) __scratch_x(group)
+#else
+#define __core1_func(func_name) func_name
+#define __core1_data(group)
+#endif
+
+#endif // CORE1_PLACEMENT_H
@@ -0,0 +1,94 @@
+#ifndef FREQUENCY_SWEEP_H
+#define FREQUENCY_SWEEP_H
+
+#include <pico/stdlib.h>
+#include <stdint.h>
+#include <ad9833.h>
+#include <core1_placement.h>
+
+#define SWEEP_STEP_COUNT (32) // number of frequencies measured per sweep.
+#define SWEEP_SETTLE_PERIODS (256ul) // periods to wait after changing
+                                     // frequency before measuring. Covers
+                                     // the queued SPI write and the analog
+                                     // front-end settling time.
+#define SWEEP_MEASURE_PERIODS (256ul) // periods averaged per step. This should
+                                      // be a power of 2.
+#define SWEEP_MIN_FREQ_HZ (100000ul) // One full period must fit in the
+                                     // sampled window (20 samples @ 2MHz).
+#define SWEEP_MAX_FREQ_HZ (1000000ul) // Nyquist frequency of the 2MHz ADC.
+
+// General strategy:
+// Step the AD9833 excitation frequency linearly from a start to a stop
+// frequency in SWEEP_STEP_COUNT steps. At each step, wait for the signal to
+// settle, then average the raw (demodulated) amplitude over
+// SWEEP_MEASURE_PERIODS periods and store it in a table.
+// The measured amplitude is proportional to the impedance of the sensing node,
+// so the table can be used to pick the excitation frequency per spout/cable.
+// Frequency writes are queued through the AD9833's DMA path, so update() never
+// blocks and can be called from the core1 detection loop.
+
+class FrequencySweep
+{
+public:
+
+    // Finite State Machine states (one-hot encoded).
+    enum State
+    {
+        IDLE = 0b0001,
+        SETTLING = 0b0010,
+        MEASURING = 0b0100,
+        RESTORING = 0b1000
+    };
+
+    FrequencySweep(AD9833& fn_gen);
+    ~FrequencySweep();
+
+/**
+ * \brief start a sweep from \p start_hz to \p stop_hz (inclusive). Once
+ *  finished, the excitation frequency is restored to \p restore_hz.
+ */
+    void start(uint32_t start_hz, uint32_t stop_hz, uint32_t restore_hz);
+
+/**
+ * \brief abort a sweep in progress and restore the excitation frequency.
+ */
+    void abort();
+
+/**
+ * \brief update finite state machine with one period's raw amplitude.
+ */
+    void update(uint32_t raw_amplitude);
+
+    inline bool is_running()
+        {return state_ != IDLE;}
+    inline bool sweep_finished()
+        {return sweep_finished_;}
+    inline void clear_sweep_finished_flag()
+        {sweep_finished_ = false;}
+
+/**
+ * \brief frequency of step \p step_index for the current sweep settings.
+ */
+    uint32_t step_frequency_hz(size_t step_index);
+
+// Public Data members.
+    uint16_t amplitudes_[SWEEP_STEP_COUNT]; /// averaged raw amplitude per step.
+
+private:
+    void start_step();
+
+    AD9833& fn_gen_;
+    State state_;
+
+    uint32_t start_hz_;
+    uint32_t stop_hz_;
+    uint32_t restore_hz_;
+
+    size_t step_index_;
+    size_t period_count_;
+    uint32_t amplitude_sum_;
+    uint32_t log2_measure_periods_;
+
+    bool sweep_finished_;
+};
+#endif // FREQUENCY_SWEEP_H
@@ -3,43 +3,94 @@
 
 #include <tgmath.h>
 #include <pico/stdlib.h>
-#include <hardware/dma.h>
-#include <hardware/regs/dreq.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <hardware/irq.h>
-
-#include <bitset>
-
-#define BASELINE_SAMPLE_INTERVAL (3000ul) // number of periods between
-                                          // updating the baseline threshold.
-                                          // 100KHz/1000 periods = 100Hz update rate.
-#define UPSCALE_FACTOR (128) // Factor by which to multiply incoming
-#define MOVING_AVG_WINDOW (2ul) // This should be:
-                                 // a.) <=64 or the data will arrive late.
-                                 // b.) a power of 2.
-#define BASELINE_AVG_WINDOW (128)
-#define CONSENSUS_WINDOW (64)
+
+#include <amplitude_estimator.h>
+#include <core1_placement.h>
+
+#define CONSENSUS_WINDOW (64) // default (and maximum) consensus window.
 #define DEFAULT_ON_THRESHOLD_PERCENT (90)
 #define DEFAULT_OFF_THRESHOLD_PERCENT (98)
+#define DEFAULT_GUARD_PERCENT (95) // Idle (decimatable) above this amplitude.
+// Thresholds are stored as Q16 fractions of the baseline (65536 = 100%).
+#define PERCENT_TO_Q16(percent) ((((uint32_t)(percent) << 16) + 50) / 100)
+#define Q16_TO_PERCENT(q16) (((uint32_t)(q16) * 100 + 32768) >> 16)
+#define DEFAULT_ON_THRESHOLD_Q16 (PERCENT_TO_Q16(DEFAULT_ON_THRESHOLD_PERCENT))
+#define DEFAULT_OFF_THRESHOLD_Q16 (PERCENT_TO_Q16(DEFAULT_OFF_THRESHOLD_PERCENT))
+#define DEFAULT_GUARD_Q16 (PERCENT_TO_Q16(DEFAULT_GUARD_PERCENT))
 
 #define FILTER_WARMUP_ITERATION_COUNT (300ul)
 
-#define LICK_HOLD_TIME_MS (10) // minimum amount of time lick detection trigger
-                               // will be asserted.
+#define DEFAULT_CUSUM_THRESHOLD_Q4 (64) // CUSUM decision limit in units of the
+                                        // on-threshold deficit (Q4: 16 = 1x).
+#define LOG2_NOISE_MAD_WINDOW (8) // periods averaged (as a power of 2) for
+                                  // the amplitude noise estimate.
+
+#define DEFAULT_ZSCORE_K_Q4 (64) // Z-score on-threshold in standard
+                                 // deviations below the mean (Q4: 16 = 1).
+#define LOG2_ZSCORE_WINDOW (15) // periods (as a power of 2) the amplitude
+                                // mean and variance are tracked over.
+#define ZSCORE_MIN_PERIODS (4096ul) // periods tracked before the z-score
+                                    // thresholds replace the fixed ones.
+#define ZSCORE_MAX_DEVIATION (32767) // upscaled. Larger deviations from the
+                                     // mean are clipped (winsorized).
+#define ZSCORE_MIN_SIGMA (UPSCALE_FACTOR / 2) // upscaled. Floor for the
+                                              // standard deviation.
+
+#define LICK_HOLD_TIME_US (10000ul) // minimum amount of time lick detection
+                                    // trigger will be asserted.
+#define NO_PIN (0xFFFFFFFFu) // Pass as ttl_pin or led_pin for no output.
 
 // General strategy:
-// ADC writes a period's worth of 100KHz data (8-bit) sampled at 2MHz
-// continuously. Every waveform period (20 samples @ 500KHz), compute sampled
-// amplitude.
-// Push sampled amplitude into a moving average of the last MOVING_AVG_WINDOW
-// samples.
-// Every BASELINE_SAMPLE_INTERVAL samples, we update the baseline "no-lick"
-// measurement.
-// If lower than threshold amplitude, lick detected.
-
-// Note: average baseline and trigger value are upscaled by UPSCALE_FACTOR, so
-//  we don't lose precision while averaging them over time.
+// A LickDetector is a lightweight threshold state machine that reads the
+// filtered amplitude and baseline of an AmplitudeEstimator. Update the
+// estimator first, then every detector that reads from it. Several detectors
+// with different thresholds, windows, and hold times can share one channel's
+// estimator (i.e: a fast touch detector and a slow proximity detector).
+// If the filtered amplitude is lower than the on-threshold, lick detected.
+
+// Detection modes:
+// CONSENSUS: trigger once all of the last consensus_window filtered
+//  amplitudes fall below the on-threshold. Fixed latency of consensus_window
+//  periods.
+// CUSUM: trigger once the cumulative sum of the amplitude deficit (baseline
+//  minus amplitude), less a drift of half the on-threshold deficit per
+//  period, exceeds a limit of cusum_threshold_q4/16 on-threshold deficits.
+//  Noise averages out against the drift, while a strong contact crosses the
+//  limit within a few periods. A contact right at the on-threshold takes
+//  2*cusum_threshold_q4/16 periods.
+// ZSCORE: trigger like CONSENSUS, but place the on-threshold k standard
+//  deviations (and the off-threshold k/2) below the mean filtered amplitude
+//  instead of at a fixed fraction of the baseline, so that the false alarm
+//  rate does not depend on how noisy the rig is. The mean and variance are
+//  tracked with Welford's algorithm in fixed point while untriggered and
+//  above the on-threshold. The count saturates at 2^LOG2_ZSCORE_WINDOW,
+//  after which old periods are forgotten exponentially so the statistics
+//  follow drift. The fixed thresholds apply until ZSCORE_MIN_PERIODS have
+//  been tracked.
+// All modes release the same way (no filtered amplitudes below the
+// off-threshold for consensus_window periods), and all respect the hold time.
+// The off-threshold sits above the on-threshold, so a contact hovering near
+// the on-threshold does not chatter.
+
+// Decimation:
+// A detector is idle while it is untriggered with its filtered amplitude
+// above a guard threshold, set between the on-threshold and the baseline.
+// Otherwise its update() asks the estimator to run at full rate. A skipped
+// period's amplitude is never measured, so the guard band must be wide
+// enough that a contact takes longer than the decimation factor to fall
+// from the guard to the on-threshold for onset latency to be unchanged.
+
+// Features of one contact (TRIGGERED to UNTRIGGERED), measured on core1.
+// Amplitudes are upscaled by UPSCALE_FACTOR.
+struct contact_features_t
+{
+    uint32_t duration_periods;
+    uint32_t upscaled_baseline; // baseline at contact onset.
+    uint32_t upscaled_min_amplitude; // deepest point of the contact.
+    uint64_t upscaled_deficit; // sum of (baseline - amplitude) per period.
+};
 
 class LickDetector
 {
@@ -54,19 +105,34 @@ public:
         TRIGGERED = 0b1000
     };
 
-    LickDetector(uint16_t* adc_vals, size_t samples_per_period,
+    enum DetectionMode: uint8_t
+    {
+        CONSENSUS = 0,
+        CUSUM = 1,
+        ZSCORE = 2
+    };
+
+/**
+ * \param consensus_window periods (1 to CONSENSUS_WINDOW) that must agree
+ *  to trigger (and untrigger).
+ */
+    LickDetector(AmplitudeEstimator& estimator,
                  uint ttl_pin, uint led_pin,
-                 uint8_t on_threshold_percent = DEFAULT_ON_THRESHOLD_PERCENT,
-                 uint8_t off_threshold_percent = DEFAULT_OFF_THRESHOLD_PERCENT);
+                 uint16_t on_threshold_q16 = DEFAULT_ON_THRESHOLD_Q16,
+                 uint16_t off_threshold_q16 = DEFAULT_OFF_THRESHOLD_Q16,
+                 size_t consensus_window = CONSENSUS_WINDOW,
+                 uint32_t hold_time_us = LICK_HOLD_TIME_US);
     ~LickDetector();
 
 /**
- * \brief reset finite state machine for lick detection.
+ * \brief reset finite state machine for lick detection. Also reseeds the
+ *  estimator's filters, so reset every detector of a channel together.
  */
-    inline void reset() {state_ = RESET;}
+    inline void reset()
+        {state_ = RESET; estimator_.reset();}
 
 /**
- * \brief update finite state machine.
+ * \brief update finite state machine. Call after updating the estimator.
  */
     void update();
 
@@ -79,61 +145,159 @@ public:
     inline void clear_lick_detection_stop_flag()
         {lick_stop_detected_ = false;}
 
-    inline void set_samples_per_period(size_t samples_per_period)
-    {samples_per_period_ = samples_per_period;}
+    inline AmplitudeEstimator& estimator()
+        {return estimator_;}
+    inline State state()
+        {return state_;}
+
+/**
+ * \brief set the interval between calls to update() and recompute any timing
+ *  that is expressed in periods. Defaults to one period of
+ *  SAMPLES_PER_PERIOD samples at ADC_SAMPLE_RATE_HZ.
+ */
+    void set_period_ns(uint32_t period_ns);
+
+/**
+ * \brief set the trigger threshold as a Q16 fraction of the baseline.
+ */
+    void set_on_threshold_q16(uint16_t on_threshold_q16);
+
+/**
+ * \brief set the untrigger threshold as a Q16 fraction of the baseline.
+ */
+    void set_off_threshold_q16(uint16_t off_threshold_q16);
+
+/**
+ * \brief set the guard threshold, below which the detector is never idle,
+ *  as a Q16 fraction of the baseline. Never lower than the on-threshold.
+ */
+    void set_guard_q16(uint16_t guard_q16);
+
+/**
+ * \brief true if this detector does not need every period.
+ */
+    inline bool idle()
+        {return state_ == UNTRIGGERED
+                && estimator_.upscaled_amplitude_avg() > guard_threshold_;}
+
+/**
+ * \brief select how lick onsets are detected. \p cusum_threshold_q4 is the
+ *  CUSUM decision limit in units of the on-threshold deficit (Q4).
+ */
+    void set_detection_mode(DetectionMode mode, uint8_t cusum_threshold_q4);
+
+    inline DetectionMode detection_mode()
+        {return detection_mode_;}
+
+/**
+ * \brief set the ZSCORE mode's on-threshold in standard deviations below
+ *  the mean (Q4).
+ */
+    void set_zscore_k_q4(uint8_t k_q4);
+
+/**
+ * \brief mean filtered amplitude and its standard deviation (both upscaled),
+ *  as of the last threshold update. Only tracked in ZSCORE mode.
+ * \return 0 until ZSCORE_MIN_PERIODS have been tracked.
+ */
+    inline uint32_t zscore_mean()
+        {return zscore_valid()? uint32_t(upscaled_mean_q16_ >> 16): 0;}
+    inline uint32_t zscore_sigma()
+        {return zscore_valid()? upscaled_sigma_: 0;}
+/**
+ * \brief CUSUM drift, decision limit, and mean absolute deviation of the
+ *  filtered amplitude from the baseline (all upscaled). Noise is only
+ *  tracked in CUSUM mode while untriggered.
+ */
+    inline uint32_t cusum_drift()
+        {return cusum_drift_;}
+    inline uint32_t cusum_limit()
+        {return cusum_limit_;}
+    inline uint32_t upscaled_noise_mad()
+        {return upscaled_noise_mad_;}
+
+/**
+ * \brief expected periods between CUSUM false alarms with no contact
+ *  (Siegmund's approximation for Gaussian noise). The amplitude's lower tail
+ *  is lighter than Gaussian, so this errs on the side of more false alarms.
+ *  Uses floating point, so call it from core0.
+ * \return 0 if the noise has not been measured.
+ */
+    static float cusum_average_run_length(uint32_t cusum_drift,
+                                          uint32_t cusum_limit,
+                                          uint32_t upscaled_noise_mad);
 
 // Public Data members.
-    uint8_t on_threshold_percent_; /// public access for speed.
-    uint8_t off_threshold_percent_; /// public access for speed.
+    contact_features_t contact_features_; /// valid once lick_stop_detected().
+    uint16_t on_threshold_q16_; /// public read access. Write with setter.
+    uint16_t off_threshold_q16_; /// public read access. Write with setter.
 
 private:
+
 /**
- * \brief compute the raw amplitude from one period of waveform samples.
- * \note this is a naive implementation of max - min. A better implementation
- *  would be the https://en.wikipedia.org/wiki/Goertzel_algorithm
+ * \brief accumulate this period's amplitude deficit into the CUSUM
+ *  statistic and the noise estimate.
  */
-    uint32_t get_raw_amplitude();
+    inline void update_cusum();
 
 /**
- * \brief
+ * \brief accumulate this period's filtered amplitude into the running mean
+ *  and variance (Welford's algorithm).
  */
-    inline void update_measurement_moving_avg();
+    inline void update_statistics();
+
+    inline bool zscore_valid()
+        {return zscore_count_ >= ZSCORE_MIN_PERIODS;}
 
 /**
- * \brief
+ * \brief forget the running mean and variance.
  */
-    inline void update_baseline_moving_avg();
+    void reset_statistics();
 
+/**
+ * \brief recompute on/off thresholds from the baseline and Q16 settings.
+ *  Only needs to be called when either of them changes.
+ */
+    void update_thresholds();
+
+    AmplitudeEstimator& estimator_;
     uint ttl_pin_;
     uint led_pin_;
-    uint16_t* adc_vals_;
-    size_t samples_per_period_;
+    uint32_t output_mask_; // gpio mask of ttl and led pins that are in use.
     State state_;
 
-#ifdef PROFILE_CPU
-public:
-#endif
-    uint32_t upscaled_baseline_avg_; // "baseline x scalar"
-    uint32_t upscaled_amplitude_avg_; // "setpoint x scalar"
-    std::bitset<CONSENSUS_WINDOW> trigger_history_; // trigger threshold history.
-#ifdef PROFILE_CPU
-private:
-#endif
-    uint32_t raw_amplitude_;
-    uint32_t upscaled_amplitude_;
-    uint32_t log2_upscale_factor_;
-    uint32_t log2_baseline_window_;
-    uint32_t log2_moving_avg_window_;
-
-    size_t sample_count_;
+    uint64_t trigger_history_; // trigger threshold history. Bit 0 is the
+                               // latest period.
+    uint64_t consensus_mask_; // the consensus_window latest bits.
+    uint32_t on_threshold_; // upscaled, like the estimator's baseline.
+    uint32_t off_threshold_; // upscaled, like the estimator's baseline.
+    uint16_t guard_q16_;
+    uint32_t guard_threshold_; // upscaled, like the estimator's baseline.
+
+    DetectionMode detection_mode_;
+    uint8_t cusum_threshold_q4_;
+    uint32_t cusum_; // upscaled, like the estimator's baseline.
+    uint32_t cusum_drift_; // upscaled deficit subtracted every period.
+    uint32_t cusum_limit_; // upscaled CUSUM value that triggers.
+    uint32_t upscaled_noise_mad_;
+
+    uint8_t zscore_k_q4_;
+    uint32_t zscore_count_; // periods tracked (saturates at the window).
+    int64_t upscaled_mean_q16_; // Q16 (upscaled) mean.
+    int64_t upscaled_variance_q16_; // Q16 (upscaled^2) variance.
+    uint32_t upscaled_sigma_; // standard deviation at the last threshold
+                              // update.
+
     size_t warmup_iterations_;
+    uint32_t hold_time_us_;
+    uint32_t hold_time_periods_;
 
     bool lick_start_detected_;
     bool lick_stop_detected_;
     bool hysteresis_elapsed_;
 
 
-    uint32_t detection_start_time_ms_;
-    uint32_t detection_stop_time_ms_;
+    uint32_t detection_start_period_;
+    uint32_t detection_stop_period_;
 };
 #endif // LICK_DETECTOR_H
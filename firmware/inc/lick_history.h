@@ -0,0 +1,55 @@
+#ifndef LICK_HISTORY_H
+#define LICK_HISTORY_H
+
+#include <pico/stdlib.h>
+#include <stdint.h>
+
+#define LICK_HISTORY_SIZE (4096ul) // number of lick events retained. This
+                                   // should be a power of 2.
+#define LICK_HISTORY_WINDOW_SIZE (16) // number of events returned per read.
+#define LICK_HISTORY_INVALID_STATE (0xFF) // state reported for events that
+                                          // were overwritten or not yet
+                                          // recorded.
+
+// General strategy:
+// Every lick state change dispatched to the host is also recorded in a ring
+// buffer along with its Harp timestamp. Each event is tagged with a
+// monotonically increasing sequence number (starting at 0), which is implicit
+// in its position in the ring. The host can compare the event count against
+// the events it actually received to find gaps (i.e: from a USB reset) and
+// backfill them by reading back a window of events starting at any sequence
+// number still in the ring.
+
+class LickHistory
+{
+public:
+    LickHistory();
+    ~LickHistory();
+
+/**
+ * \brief record a lick event.
+ */
+    void push(uint8_t state, uint64_t harp_time_us);
+
+/**
+ * \brief number of events recorded since boot, which is also the sequence
+ *  number of the next event.
+ */
+    inline uint32_t count()
+        {return count_;}
+
+/**
+ * \brief copy \p window_size events starting at sequence number \p start_seq
+ *  into the destination arrays. Events that have been overwritten or not yet
+ *  recorded are reported with a timestamp of 0 and a state of
+ *  LICK_HISTORY_INVALID_STATE.
+ */
+    void copy_window(uint32_t start_seq, uint64_t* harp_times_us,
+                     uint8_t* states, size_t window_size);
+
+private:
+    uint64_t harp_times_us_[LICK_HISTORY_SIZE];
+    uint8_t states_[LICK_HISTORY_SIZE];
+    uint32_t count_;
+};
+#endif // LICK_HISTORY_H
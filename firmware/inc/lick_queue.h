@@ -2,15 +2,125 @@
 #define LICK_QUEUE_H
 
 #include <pico/util/queue.h>
+#include <frequency_sweep.h>
+#include <lick_detector.h>
+#include <ttl_output.h>
+#include <noise_monitor.h>
+#include <waveform_capture.h>
 
 struct lick_event_t
 {
     uint8_t state; // current state of all lick detectors
-    uint64_t pico_time_us; // when this state started.
+    uint64_t period; // sample clock count (periods since the stream started)
+                     // when this state started.
+    uint64_t stream_start_us; // system time when the sample clock started.
+    uint32_t sample_rate_hz; // ADC samples per second.
+    uint16_t samples_per_period; // ADC samples per sample clock period.
+};
+
+struct lick_features_event_t
+{
+    uint8_t channel; // index of the lick detector that measured the contact.
+    uint64_t period; // sample clock count when the contact ended. Identical
+                     // to the corresponding lick_event_t's.
+    uint64_t stream_start_us; // system time when the sample clock started.
+    uint32_t sample_rate_hz; // ADC samples per second.
+    uint16_t samples_per_period; // ADC samples per sample clock period.
+    contact_features_t features;
+};
+
+struct detector_settings_t
+{
+    uint8_t settings; // settings register contents.
+    uint32_t sample_rate_hz; // ADS7049 sample rate.
+    uint16_t samples_per_period; // ADS7049 samples per lick detector update.
+};
+
+struct detection_mode_t
+{
+    uint8_t mode; // a LickDetector::DetectionMode.
+    uint8_t cusum_threshold_q4; // CUSUM decision limit (Q4 on-deficits).
+    uint8_t zscore_k_q4; // z-score on-threshold (Q4 standard deviations).
+};
+
+struct decimation_t
+{
+    uint8_t factor; // idle detectors update every factor-th period.
+    uint16_t guard_q16; // idle above this Q16 fraction of the baseline.
+};
+
+struct proximity_thresholds_t
+{
+    uint16_t on_threshold_q16; // Q16 fraction of Channel0's baseline.
+    uint16_t off_threshold_q16; // Q16 fraction of Channel0's baseline.
+};
+
+struct time_division_t
+{
+    uint8_t slot_count; // slots in the schedule. 0 or 1 disables it.
+    uint8_t board_index; // this board's slot.
+    uint16_t slot_us; // slot duration.
+    int64_t harp_offset_us; // Harp time minus system time.
+};
+
+struct detector_stats_t
+{
+    uint32_t cusum_drift; // Channel0's CUSUM drift (upscaled).
+    uint32_t cusum_limit; // Channel0's CUSUM decision limit (upscaled).
+    uint32_t noise_mad; // Channel0's amplitude noise (upscaled).
+    uint32_t zscore_mean; // Channel0's mean amplitude (upscaled).
+    uint32_t zscore_sigma; // Channel0's amplitude standard deviation
+                           // (upscaled).
+    uint32_t period_ns; // duration of one sample clock period.
+    uint32_t processed_periods; // Channel0 periods updated since the last
+                                // report.
+    uint32_t skipped_periods; // Channel0 periods skipped while idle.
+};
+
+struct acquisition_fault_t
+{
+    uint32_t recovery_count; // stream restarts since boot.
+    uint64_t time_us; // system time of the restart.
+};
+
+struct noise_capture_t
+{
+    uint16_t samples[NOISE_MAX_WINDOW_SAMPLES]; // consecutive ADS7049 samples.
+    uint16_t sample_count;
+    uint16_t periods; // whole excitation periods in the capture.
+};
+
+struct waveform_request_t
+{
+    uint8_t state; // requested WaveformCapture::State. IDLE disarms, ARMED
+                   // arms, and TRIGGERED triggers an armed capture.
+    uint16_t pre_trigger_periods;
+    uint16_t post_trigger_periods;
+};
+
+struct waveform_event_t
+{
+    uint64_t period; // sample clock count of the trigger period.
+    uint64_t stream_start_us; // system time when the sample clock started.
+    uint32_t sample_rate_hz; // ADC samples per second.
+    uint16_t samples_per_period; // ADC samples per sample clock period.
+};
+
+struct sweep_request_t
+{
+    bool start; // true to start a sweep; false to abort one in progress.
+    uint32_t start_hz;
+    uint32_t stop_hz;
+};
+
+struct sweep_result_t
+{
+    uint16_t amplitudes[SWEEP_STEP_COUNT]; // averaged raw amplitude per step.
 };
 
 // Queues are shared across cores.
 extern queue_t lick_event_queue;
+extern queue_t lick_features_queue;
 
 // Additional queues for adjusting lick detector thresholds from Harp registers.
 extern queue_t set_on_threshold_queue;
@@ -18,5 +128,35 @@ extern queue_t set_off_threshold_queue;
 extern queue_t get_on_threshold_queue;
 extern queue_t get_off_threshold_queue;
 extern queue_t detector_settings_queue;
+extern queue_t detection_mode_queue;
+extern queue_t decimation_queue;
+extern queue_t proximity_thresholds_queue;
+extern queue_t time_division_queue;
+extern queue_t detector_stats_queue;
+
+// Queue for reporting acquisition stream stalls (and recoveries) to core0.
+extern queue_t acquisition_fault_queue;
+
+// Queue for handing raw captures to core0's noise-floor monitor.
+extern queue_t noise_capture_queue;
+
+// Queues for arming/triggering the raw waveform capture and reporting a
+// finished snapshot.
+extern queue_t waveform_request_queue;
+extern queue_t waveform_event_queue;
+
+// Queues for running a frequency sweep on core1 from Harp registers.
+extern queue_t sweep_request_queue;
+extern queue_t sweep_result_queue;
+
+// Queue for configuring the PIO-driven TTL output from Harp registers.
+extern queue_t ttl_config_queue;
+
+// Doorbells. Set by one core after pushing into any queue read by the other
+// core, so the reader only takes the queues' spin locks when there is work.
+// The reader must clear the doorbell *before* draining its queues so that no
+// push is missed.
+extern volatile bool core0_doorbell; // rung by core1.
+extern volatile bool core1_doorbell; // rung by core0.
 
 #endif // LICK_QUEUE_H
@@ -0,0 +1,66 @@
+#ifndef NOISE_MONITOR_H
+#define NOISE_MONITOR_H
+
+#include <pico/stdlib.h>
+#include <stdint.h>
+#include <config.h>
+
+#define NOISE_MAX_WINDOW_SAMPLES (256) // samples analyzed per capture.
+#define NOISE_MIN_WINDOW_PERIODS (3) // fewest whole periods per capture. Needed
+                                     // to place bins on both sides of the
+                                     // excitation frequency.
+#define NOISE_CAPTURE_INTERVAL_PERIODS (10000ul) // periods between captures
+                                                 // (100ms @ 100KHz).
+#define NOISE_BIN_COUNT (4) // off-excitation bins that measure the floor.
+#define NOISE_COEF_FRAC_BITS (14) // Goertzel coefficients are Q14.
+#define NOISE_MAX_SNR_DB_X10 (1000) // SNR reported with no measurable floor.
+#define NOISE_INTERFERENCE_SNR_DB_X10 (200) // Interference is flagged below
+                                            // this SNR [0.1dB]...
+#define NOISE_CLEAR_SNR_DB_X10 (230) // ...and cleared above this one.
+
+// General strategy:
+// Core1 occasionally copies a few consecutive periods of ADS7049 samples into
+// a capture and hands it to core0, which does all the math here, so the
+// detection loop only pays for a copy. The capture spans a whole number of
+// excitation periods, so the excitation lands exactly on DFT bin k = periods
+// with no leakage. A fixed-point Goertzel filter measures the power at that
+// bin and at bins k-2, k-1, k+1, k+2, which lie inside the analog front-end's
+// passband but away from the excitation. Their average is the noise floor.
+// Mains pickup, neighboring rigs, and switching supplies show up as a rising
+// floor (a falling SNR) well before they cause false licks.
+
+class NoiseMonitor
+{
+public:
+    NoiseMonitor();
+    ~NoiseMonitor();
+
+/**
+ * \brief estimate SNR and update the interference flag from \p periods
+ *  consecutive excitation periods in \p samples.
+ * \return true if the interference flag changed.
+ */
+    bool analyze(const uint16_t* samples, size_t sample_count, size_t periods);
+
+/**
+ * \brief clear the estimate, ie: when the signal chain changes.
+ */
+    void reset();
+
+    inline uint16_t snr_db_x10()
+        {return snr_db_x10_;}
+    inline bool interference_detected()
+        {return interference_;}
+
+private:
+/**
+ * \brief power at DFT bin \p k of an \p n -sample window with the mean
+ *  removed. Upscaled by an arbitrary but constant factor.
+ */
+    uint64_t goertzel_power(const uint16_t* samples, size_t n, size_t k,
+                            int32_t mean);
+
+    uint16_t snr_db_x10_;
+    bool interference_;
+};
+#endif // NOISE_MONITOR_H
@@ -0,0 +1,92 @@
+#ifndef TIME_DIVISION_H
+#define TIME_DIVISION_H
+
+#include <pico/stdlib.h>
+#include <stdint.h>
+#include <core1_placement.h>
+
+#define TIME_DIVISION_MAX_SLOTS (16)
+#define TIME_DIVISION_DEFAULT_SLOT_US (1000ul)
+#define TIME_DIVISION_MIN_SLOT_US (500ul)
+#define TIME_DIVISION_GUARD_US (100ul) // not sampled at either end of a slot,
+                                       // for the excitation and analog
+                                       // front-end to settle and to absorb
+                                       // clock offsets between boards.
+
+// General strategy:
+// Boards that share a rig (and a Harp clock) split time into a repeating
+// schedule of slot_count slots of slot_us each, aligned to Harp time 0.
+// Each board excites its electrode only during the slot matching its board
+// index, so neighbouring boards never excite at the same time. Periods are
+// only sampled if they lie entirely within the board's own slot, away from
+// its edges by the guard time. Detection holds its state in between.
+// Slot boundaries are tracked incrementally as time advances so that the
+// per-period cost is a comparison. The 64-bit division to locate the slot
+// only runs after configuring or if the clock jumps (i.e: when the Harp
+// clock is resynchronized).
+// The schedule only depends on the time it is given, so it can be run
+// against a simulated clock.
+
+class TimeDivision
+{
+public:
+    TimeDivision();
+    ~TimeDivision();
+
+/**
+ * \brief set up the schedule. A slot_count of 0 or 1 disables it.
+ * \param board_index this board's slot (0 to slot_count - 1).
+ * \param slot_us slot duration. At least TIME_DIVISION_MIN_SLOT_US.
+ */
+    void configure(uint8_t slot_count, uint8_t board_index, uint32_t slot_us);
+
+    inline bool enabled()
+        {return slot_count_ > 1;}
+
+/**
+ * \brief advance the schedule to \p harp_time_us. Time may jump in either
+ *  direction.
+ */
+    void update(uint64_t harp_time_us);
+
+/**
+ * \brief true if this board may excite its electrode, as of the last
+ *  update(). Always true if disabled.
+ */
+    inline bool excitation_enabled()
+        {return !enabled() || slot_ == board_index_;}
+
+/**
+ * \brief true if the period of \p period_us that ended at the last update()
+ *  lies within this board's slot, excluding the guard time at both edges.
+ *  Always true if disabled.
+ */
+    inline bool sampling(uint32_t period_us)
+        {return !enabled()
+                || (slot_ == board_index_
+                    && slot_offset_us_ >= TIME_DIVISION_GUARD_US + period_us
+                    && slot_offset_us_ <= slot_us_ - TIME_DIVISION_GUARD_US);}
+
+/**
+ * \brief slot active as of the last update().
+ */
+    inline uint8_t slot()
+        {return slot_;}
+
+private:
+/**
+ * \brief locate the slot that contains \p harp_time_us from scratch.
+ */
+    void resync(uint64_t harp_time_us);
+
+    uint8_t slot_count_;
+    uint8_t board_index_;
+    uint32_t slot_us_;
+    uint64_t cycle_us_; // duration of the whole schedule.
+
+    bool synced_;
+    uint8_t slot_; // slot active as of the last update().
+    uint64_t slot_start_us_; // Harp time at which slot_ started.
+    uint32_t slot_offset_us_; // time into slot_ as of the last update().
+};
+#endif // TIME_DIVISION_H
@@ -0,0 +1,93 @@
+#ifndef TTL_OUTPUT_H
+#define TTL_OUTPUT_H
+
+#include <pico/stdlib.h>
+#include <stdint.h>
+#include <hardware/pio.h>
+#include <hardware/clocks.h>
+#include <ttl_output.pio.h>
+#include <core1_placement.h>
+
+#define TTL_PIO_CLK_HZ (1000000ul) // state machine tick rate. 1[us] resolution.
+#define TTL_MIN_PULSE_WIDTH_US (3) // overhead of the pulse train program.
+#define TTL_MIN_PULSE_LOW_US (4) // overhead of the pulse train program.
+
+#define DEFAULT_TTL_PULSE_WIDTH_US (1000)
+#define DEFAULT_TTL_PULSE_PERIOD_US (2000)
+#define DEFAULT_TTL_PULSE_COUNT (1)
+#define DEFAULT_TTL_BOUT_GAP_MS (500)
+
+// TTL output configuration, written from Harp registers.
+struct ttl_config_t
+{
+    uint8_t mode; // a TtlOutput::Mode.
+    uint16_t pulse_width_us;
+    uint16_t pulse_period_us;
+    uint8_t pulse_count;
+    uint16_t bout_gap_ms; // licks closer together than this form one bout.
+};
+
+// General strategy:
+// A PIO state machine owns the TTL pin, so edge timing and pulse widths do not
+// depend on the cpu. The cpu only pushes a trigger word (or words) into the
+// state machine's TX FIFO upon a lick start or stop. Level mode loads a program
+// that copies the pushed bit to the pin. All other modes load a pulse train
+// program.
+
+class TtlOutput
+{
+public:
+    enum Mode: uint8_t
+    {
+        LEVEL = 0, // TTL is high while a lick is detected.
+        PULSE = 1, // one fixed-width pulse per lick.
+        PULSE_TRAIN = 2, // pulse_count pulses per lick.
+        BOUT_ONE_SHOT = 3 // one fixed-width pulse per bout of licks.
+    };
+
+    TtlOutput(PIO pio, uint pin);
+    ~TtlOutput();
+
+/**
+ * \brief apply a new configuration. Loads the state machine program for the
+ *  mode and drives the pin low.
+ */
+    void set_config(const ttl_config_t& config);
+
+/**
+ * \brief drop any queued triggers and drive the pin low. Call whenever the
+ *  lick detector driving this output is reset.
+ */
+    inline void reset() {set_config(config_);}
+
+/**
+ * \brief push a trigger for a lick start. Does not block.
+ */
+    void lick_started();
+
+/**
+ * \brief push a trigger for a lick stop. Does not block.
+ */
+    void lick_stopped();
+
+private:
+/**
+ * \brief queue one pulse train if there is room in the TX FIFO.
+ */
+    void push_pulse_train(uint32_t pulse_count);
+
+    void load_program(const pio_program_t* program);
+
+    PIO pio_;
+    uint pin_;
+    uint sm_;
+    const pio_program_t* program_; // currently-loaded program.
+    uint program_offset_;
+
+    ttl_config_t config_;
+    uint32_t high_cycles_; // precomputed pulse train words.
+    uint32_t low_cycles_;
+
+    uint64_t last_lick_stop_us_; // for bout detection.
+};
+#endif // TTL_OUTPUT_H
@@ -0,0 +1,132 @@
+#ifndef WAVEFORM_CAPTURE_H
+#define WAVEFORM_CAPTURE_H
+
+#include <pico/stdlib.h>
+#include <stdint.h>
+#include <config.h>
+#include <core1_placement.h>
+
+#define WAVEFORM_RING_SAMPLES (4096ul) // raw samples retained (204 periods
+                                       // at 20 samples per period).
+#define WAVEFORM_MAX_PERIODS (WAVEFORM_RING_SAMPLES \
+                              / ADS7049_MIN_SAMPLES_PER_PERIOD)
+#define WAVEFORM_WINDOW_SIZE (64) // samples (or amplitudes) returned per read.
+#define DEFAULT_WAVEFORM_PRE_TRIGGER_PERIODS (100)
+#define DEFAULT_WAVEFORM_POST_TRIGGER_PERIODS (100)
+
+// General strategy:
+// While armed, every period's raw samples (and that period's raw amplitude)
+// are copied into a ring that holds as many whole periods as fit in
+// WAVEFORM_RING_SAMPLES. A trigger (lick onset or host request) marks the
+// latest period. Once the requested number of post-trigger periods have
+// been recorded, the ring freezes. The frozen snapshot spans up to the
+// requested pre-trigger periods, the trigger period, and the post-trigger
+// periods, and stays untouched until the capture is armed again, so core0
+// can read it out in windows at its leisure.
+// Only arm()/trigger()/push() run on core1. The copy functions must only be
+// called while the capture is READY.
+
+class WaveformCapture
+{
+public:
+
+    // Capture states. Also reported to the host.
+    enum State: uint8_t
+    {
+        IDLE = 0,
+        ARMED = 1,
+        TRIGGERED = 2,
+        READY = 3
+    };
+
+    WaveformCapture();
+    ~WaveformCapture();
+
+/**
+ * \brief clear the ring and return to IDLE. Call whenever the samples per
+ *  period change.
+ */
+    void configure(size_t samples_per_period);
+
+/**
+ * \brief start recording. Pre-trigger periods are clipped to what fits in
+ *  the ring.
+ */
+    void arm(size_t pre_trigger_periods, size_t post_trigger_periods);
+
+/**
+ * \brief stop recording without producing a snapshot.
+ */
+    inline void disarm()
+        {state_ = IDLE;}
+
+/**
+ * \brief mark the most recently pushed period as the trigger. Ignored
+ *  unless ARMED.
+ */
+    void trigger();
+
+/**
+ * \brief record one period of samples and its raw amplitude.
+ */
+    inline void push(const uint16_t* samples, uint32_t raw_amplitude)
+    {
+        if (state_ == ARMED || state_ == TRIGGERED)
+            record(samples, raw_amplitude);
+    }
+
+/**
+ * \brief number of whole periods that fit in the ring at the current
+ *  samples per period.
+ */
+    inline size_t capacity_periods()
+        {return capacity_periods_;}
+
+    inline State state()
+        {return state_;}
+    inline bool capture_finished()
+        {return capture_finished_;}
+    inline void clear_capture_finished_flag()
+        {capture_finished_ = false;}
+    inline size_t samples_per_period()
+        {return samples_per_period_;}
+    inline size_t period_count()
+        {return period_count_;}
+    inline size_t trigger_index()
+        {return trigger_index_;}
+
+/**
+ * \brief copy \p count raw samples of the snapshot starting at sample
+ *  \p start. Samples past the end of the snapshot are zeroed.
+ */
+    void copy_samples(uint32_t start, uint16_t* dest, size_t count);
+
+/**
+ * \brief copy \p count per-period raw amplitudes of the snapshot starting
+ *  at period \p start. Amplitudes past the end of the snapshot are zeroed.
+ */
+    void copy_amplitudes(uint32_t start, uint16_t* dest, size_t count);
+
+private:
+    void record(const uint16_t* samples, uint32_t raw_amplitude);
+
+    uint16_t samples_[WAVEFORM_RING_SAMPLES];
+    uint16_t amplitudes_[WAVEFORM_MAX_PERIODS];
+
+    volatile State state_;
+    size_t samples_per_period_;
+    size_t capacity_periods_;
+    size_t pre_trigger_periods_;
+    size_t post_trigger_periods_;
+
+    size_t head_; // ring slot (in periods) of the next write.
+    size_t filled_; // periods written since arming (up to capacity).
+    size_t remaining_; // post-trigger periods left to record.
+
+    size_t first_slot_; // ring slot of the snapshot's first period.
+    size_t period_count_; // periods in the snapshot.
+    size_t trigger_index_; // snapshot period that triggered.
+
+    bool capture_finished_;
+};
+#endif // WAVEFORM_CAPTURE_H
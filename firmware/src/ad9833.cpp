@@ -28,7 +28,8 @@ AD9833::AD9833(uint32_t mclk_frequency_hz, spi_inst_t* spi_hw,
 
 AD9833::AD9833(uint32_t mclk_frequency_hz, spi_inst_t* spi_hw, uint8_t cs_pin)
 :mclk_frequency_hz_{mclk_frequency_hz}, spi_inst_{spi_hw}, cs_pin_{cs_pin},
- device_is_reset_{false}
+ device_is_reset_{false}, queued_words_{0}, fill_index_{0}, dma_chan_{-1},
+ waveform_{SINE}
 {
     // Setup chip select.
     gpio_init(cs_pin_);
@@ -48,9 +49,60 @@ void AD9833::init_spi(spi_inst_t* spi_hw)
                    SPI_MSB_FIRST);
 }
 
+void AD9833::setup_dma_writes()
+{
+    // Let the SPI peripheral drive chip select so that every 16-bit frame is
+    // latched without cpu intervention.
+    gpio_set_function(cs_pin_, GPIO_FUNC_SPI);
+    dma_chan_ = dma_claim_unused_channel(true);
+    dma_channel_config conf = dma_channel_get_default_config(dma_chan_);
+    channel_config_set_transfer_data_size(&conf, DMA_SIZE_16);
+    channel_config_set_read_increment(&conf, true);
+    channel_config_set_write_increment(&conf, false); // write to SPI data reg.
+    channel_config_set_dreq(&conf, spi_get_dreq(spi_inst_, true)); // TX pace.
+    dma_channel_configure(
+        dma_chan_,
+        &conf,
+        &spi_get_hw(spi_inst_)->dr, // write (dst) address. Does not change.
+        nullptr,    // read (src) address will be loaded per transfer.
+        0,          // transfer count will be loaded per transfer.
+        false);     // Don't start immediately.
+}
+
+void __core1_func(AD9833::service)()
+{
+    if (queued_words_ == 0 || dma_channel_is_busy(dma_chan_))
+        return;
+    // Launch the filled buffer and start filling the other one.
+    dma_channel_transfer_from_buffer_now(dma_chan_, write_queue_[fill_index_],
+                                         queued_words_);
+    fill_index_ ^= 1u;
+    queued_words_ = 0;
+}
+
+bool AD9833::writes_pending()
+{
+    if (dma_chan_ < 0)
+        return false;
+    return (queued_words_ > 0) || dma_channel_is_busy(dma_chan_);
+}
+
 // Bit D15 and D14 give the address of the register.
 void AD9833::spi_write16(uint16_t word)
 {
+    if (dma_chan_ >= 0)
+    {
+        // Only wait if we have run out of queue space, which only happens
+        // if more than one queue's worth of words is written at once.
+        if (queued_words_ == AD9833_WRITE_QUEUE_SIZE)
+        {
+            dma_channel_wait_for_finish_blocking(dma_chan_);
+            service();
+        }
+        write_queue_[fill_index_][queued_words_++] = word;
+        service();
+        return;
+    }
     // CS LOW
     asm volatile("nop");
     gpio_put(cs_pin_, 0);
@@ -63,7 +115,9 @@ void AD9833::spi_write16(uint16_t word)
     //asm volatile("nop \n nop \n nop");
     gpio_put(cs_pin_, 1);
     //asm volatile("nop \n nop \n nop");
+#if defined(DEBUG)
     printf("Writing 0x%04x\n", word);
+#endif
 }
 
 void AD9833::write_to_reg(RegName reg, uint16_t value)
@@ -82,15 +136,16 @@ void AD9833::reset()
 
 void AD9833::clear_reset()
 {
-    // write previously written control reg value
+    // Rewrite the last waveform bits with D8 (RESET) cleared.
     device_is_reset_ = false; // Clear local reset state.
-    write_to_reg(CONTROL, 0x0000); // Write 0 to D8.
+    write_to_reg(CONTROL, waveform_); // Clear RESET, keep the waveform.
 }
 
 void AD9833::enable_with_waveform(waveform_t waveform)
 {
 
     device_is_reset_ = false; // Clear local reset state.
+    waveform_ = waveform;
     write_to_reg(CONTROL, waveform);
 }
 
@@ -100,7 +155,8 @@ void AD9833::set_frequency_hz(uint32_t freq)
                                   /uint64_t(mclk_frequency_hz_));
     //printf("(Raw freq word is: 0x%08lx)\n", freq_word);
     // Enable two consecutive writes to FREQ0 (D13 = 1).
-    write_to_reg(CONTROL, (1<<13));
+    // Preserve the waveform such that this can be called while running.
+    write_to_reg(CONTROL, (1<<13) | waveform_);
     // Write LSBs to FREQ0 (14 lower bits).
     write_to_reg(FREQ_0, 0x03FFF & uint16_t(freq_word)); // truncate
     // Write MSBs to FREQ0 (14 upper bits).
@@ -110,21 +166,18 @@ void AD9833::set_frequency_hz(uint32_t freq)
 
 void AD9833::set_phase(float offset)
 {
-    // FIXME: divide-by-zero error.
-    // TODO: wrap value between 0-2pi.
-    float pi = atan(1) * 4;
-    uint32_t phase_bits = (2 * pi / offset) * (2<<28);
+    // Wrap offset to 0-2pi and scale it to the 12-bit phase register.
+    float two_pi = atan(1) * 8;
+    offset = fmod(offset, two_pi);
+    if (offset < 0)
+        offset += two_pi;
+    uint32_t phase_bits = uint32_t((offset / two_pi) * 4096) & 0x0FFF;
     set_phase_raw(phase_bits);
 }
 
 void AD9833::set_phase_raw(uint32_t phase_bits)
 {
-    // Set the control register B28 = 1 (i.e: D13 = 1) to set the phase in
-    // two consecutive writes.
-    // Write lower 14; write upper 14.
-    // Enable two consecutive writes to PHASE0 (D13 = 1).
-    write_to_reg(CONTROL, (1<<13));
-    write_to_reg(PHASE_0, 0x03FFF & uint16_t(phase_bits));
-    write_to_reg(PHASE_0, 0x03FFF & uint16_t(phase_bits >> 14));
+    // Phase registers are 12 bits wide and are written in a single write.
+    // (D12 is a don't-care bit.)
+    write_to_reg(PHASE_0, 0x0FFF & uint16_t(phase_bits));
 }
-
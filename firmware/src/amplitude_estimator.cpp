@@ -0,0 +1,105 @@
+#include <amplitude_estimator.h>
+
+AmplitudeEstimator::AmplitudeEstimator(uint16_t* adc_vals,
+                                       size_t samples_per_period)
+:adc_vals_{adc_vals},
+ samples_per_period_{samples_per_period},
+ upscaled_baseline_avg_{0}, upscaled_amplitude_avg_{0},
+ raw_amplitude_{0}, upscaled_amplitude_{0},
+ sample_count_{0}, period_count_{0},
+ reset_{true}, reseeded_{false}, baseline_updated_{false},
+ full_rate_{true}, skipped_{false}
+{
+    // Pre-compute constants used in update loop.
+    // We will speed up multiplication-by-2 by converting it to bitshifts.
+    log2_upscale_factor_ = log2(UPSCALE_FACTOR);
+    log2_baseline_window_ = log2(BASELINE_AVG_WINDOW);
+    log2_moving_avg_window_ = log2(MOVING_AVG_WINDOW);
+}
+
+AmplitudeEstimator::~AmplitudeEstimator(){}
+
+uint32_t __core1_func(AmplitudeEstimator::get_raw_amplitude)()
+{
+    // Compute amplitude. Naive (but very fast) implementation.
+    uint32_t max = adc_vals_[0];
+    uint32_t min = adc_vals_[0];
+    for (size_t i = 0; i < samples_per_period_; ++i)
+    {
+        if (adc_vals_[i] < min)
+            min = adc_vals_[i];
+        if (adc_vals_[i] > max)
+            max = adc_vals_[i];
+    }
+    return max - min;
+}
+
+void __core1_func(AmplitudeEstimator::update_measurement_moving_avg)()
+{
+    // Moving average is basically an IIR filter.
+    // Example for window size of 16:
+    // avg[i] = 15/16 * avg[i-1] + 1/16 * sample[i]
+    //upscaled_amplitude_avg_ = (((MOVING_AVG_WINDOW-1) * upscaled_amplitude_avg_)
+    upscaled_amplitude_avg_ = (__mul_instruction((MOVING_AVG_WINDOW-1),
+                                                 upscaled_amplitude_avg_)
+                               >> log2_moving_avg_window_)
+                          + (upscaled_amplitude_ >> log2_moving_avg_window_);
+}
+
+void __core1_func(AmplitudeEstimator::update_baseline_moving_avg)()
+{
+    //upscaled_baseline_avg_ = (((BASELINE_AVG_WINDOW-1) * upscaled_baseline_avg_)
+    upscaled_baseline_avg_ = (__mul_instruction((BASELINE_AVG_WINDOW-1),
+                                                upscaled_baseline_avg_)
+                              >> log2_baseline_window_)
+                            + (upscaled_amplitude_ >> log2_baseline_window_);
+}
+
+void __core1_func(AmplitudeEstimator::update)()
+{
+    // Note: this function must only work with integer math!
+    // Note: this function cannot block.
+    ++period_count_;
+    bool resumed = skipped_; // The last period was skipped.
+    skipped_ = false;
+    full_rate_ = false; // Until a state machine says otherwise.
+    baseline_updated_ = false;
+    reseeded_ = reset_;
+    // Update counter for baseline measurement.
+    sample_count_ = (sample_count_ >= BASELINE_SAMPLE_INTERVAL)?
+                    0:
+                    sample_count_ + 1;
+    // Take raw measurement.
+    // If we want to reject spurious noise that is 3-4x larger than the original
+    // signal, we could do that here.
+    raw_amplitude_ = get_raw_amplitude();
+    // Update primary amplitude measurement.
+    upscaled_amplitude_ = raw_amplitude_ << log2_upscale_factor_;
+    if (reset_)
+    {
+        // Reset IIR filters.
+        // Set starting values for baseline
+        // "Not Licking" signal (super slow moving average w/ big window) &
+        // current sample signal (fast moving average w/ small window).
+        // Values cannot be initialized to 0, or the filters will take longer
+        // to "charge" to the approximate actual value on startup.
+        upscaled_amplitude_avg_ = upscaled_amplitude_;
+        upscaled_baseline_avg_ = upscaled_amplitude_;
+        sample_count_ = 0;
+        reset_ = false;
+        return;
+    }
+    // Update latest measurements. The moving average cannot bridge skipped
+    // periods, so restart it from this one rather than blend in a stale
+    // amplitude.
+    if (resumed)
+        upscaled_amplitude_avg_ = upscaled_amplitude_;
+    else
+        update_measurement_moving_avg();
+    // Update baseline setpoint on slow timescale (also upscale & average).
+    if (sample_count_ == 0)
+    {
+        update_baseline_moving_avg();
+        baseline_updated_ = true;
+    }
+}
@@ -2,9 +2,12 @@
 
 
 // Setup function for the ADC and two DMA channels to
-// continuously collect 1 period of ADC samples (5 samples @ 500KHz) from the
-// 100KHz lick detector signal and write them to a fixed, known location in
+// continuously collect 1 period of 12-bit ADC samples (5 samples @ 500KHz) from
+// the 100KHz lick detector signal and write them to a fixed, known location in
 // memory where they can be processed elsewhere.
+// Alternatively, a single DMA channel collects one period at a time to
+// wherever it is (re)triggered to, so that the period can be aligned with
+// another stream.
 
 // Note: According to the datasheet sec 2.5.1, DMA read and write addresses must
 //  be pointers to an address.
@@ -15,7 +18,7 @@
 //  use the current values as start addresses for the next transfer."
 
 int samp_chan;
-uint8_t* data_ptr[1];   // Data that the reconfiguration channel will write back
+uint16_t* data_ptr[1];  // Data that the reconfiguration channel will write back
                         // to the sample channel. In this case, just the
                         // address of the location of the adc samples. This
                         // value must exist with global scope since the DMA
@@ -23,14 +26,11 @@ uint8_t* data_ptr[1];   // Data that the reconfiguration channel will write back
                         // back to the sample channel on regular intervals.
 
 /**
- * \brief init continuous sampling to a specified memory location.
+ * \brief init the ADC pins specified in the mask and set up round-robin
+ *  conversions into the ADC FIFO (with DREQ). Does not start the ADC.
  */
-void init_continuous_adc_sampling(uint8_t adc_pin_mask,
-                                  uint8_t* adc_samples_dest,
-                                  uint8_t sample_count,
-                                  bool fire_interrupt)
+static void init_adc(uint8_t adc_pin_mask)
 {
-    printf("Setting up continuous transfer of %d samples.\r\n",sample_count);
     // Setup ADC.
     // Init the ADC pins specified in the pin mask.
     for (uint8_t adc_pin_index = 0; adc_pin_index < 4; ++adc_pin_index)
@@ -64,40 +64,61 @@ void init_continuous_adc_sampling(uint8_t adc_pin_mask,
         true,    // Write each completed conversion to the sample FIFO
         true,    // Enable DMA data request (DREQ)
         1,       // Assert DREQ (and IRQ) at least 1 sample present
-        false,   // Omit ERR bit (bit 15) since we have 8 bit reads.
-        true     // shift each sample to 8 bits when pushing to FIFO
+        false,   // Omit ERR bit (bit 15).
+        false    // Keep full 12-bit samples.
     );
     adc_fifo_drain();
+}
 
-    // Get two open DMA channels.
-    // samp_chan will sample the adc, paced by DREQ_ADC and chain to ctrl_chan.
-    // ctrl_chan will reconfigure & retrigger samp_chan when samp_chan finishes.
-    samp_chan = dma_claim_unused_channel(true); // samp_chan declared in header.
-    int ctrl_chan = dma_claim_unused_channel(true);
-    printf("Sample channel: %d\r\n", samp_chan);
-    printf("Ctrl channel: %d\r\n", ctrl_chan);
+/**
+ * \brief configure samp_chan to copy \p sample_count samples from the ADC
+ *  FIFO, paced by the ADC, then chain to \p chain_to (samp_chan itself for
+ *  no chaining). Does not start it.
+ */
+static void init_sample_channel(uint8_t sample_count, bool fire_interrupt,
+                                uint chain_to)
+{
     dma_channel_config samp_conf = dma_channel_get_default_config(samp_chan);
-    dma_channel_config ctrl_conf = dma_channel_get_default_config(ctrl_chan);
-
-    // Setup Sample Channel.
-    channel_config_set_transfer_data_size(&samp_conf, DMA_SIZE_8);
+    channel_config_set_transfer_data_size(&samp_conf, DMA_SIZE_16);
     channel_config_set_read_increment(&samp_conf, false); // read from adc FIFO reg.
     channel_config_set_write_increment(&samp_conf, true);
     channel_config_set_irq_quiet(&samp_conf, !fire_interrupt);
     channel_config_set_dreq(&samp_conf, DREQ_ADC); // pace data according to ADC
-    channel_config_set_chain_to(&samp_conf, ctrl_chan);
+    channel_config_set_chain_to(&samp_conf, chain_to);
     channel_config_set_enable(&samp_conf, true);
     // Apply samp_chan configuration.
     dma_channel_configure(
         samp_chan,      // Channel to be configured
         &samp_conf,
-        nullptr,        // write (dst) address will be loaded by ctrl_chan.
+        nullptr,        // write (dst) address is loaded when (re)started.
         &adc_hw->fifo,  // read (source) address. Does not change.
         sample_count,   // Number of word transfers i.e: count_of(adc_samples_dest).
         false           // Don't Start immediately.
     );
     dma_channel_set_irq0_enabled(samp_chan, fire_interrupt);
     printf("Configured DMA sample channel.\r\n");
+}
+
+/**
+ * \brief init continuous sampling to a specified memory location.
+ */
+void init_continuous_adc_sampling(uint8_t adc_pin_mask,
+                                  uint16_t* adc_samples_dest,
+                                  uint8_t sample_count,
+                                  bool fire_interrupt)
+{
+    printf("Setting up continuous transfer of %d samples.\r\n",sample_count);
+    init_adc(adc_pin_mask);
+
+    // Get two open DMA channels.
+    // samp_chan will sample the adc, paced by DREQ_ADC and chain to ctrl_chan.
+    // ctrl_chan will reconfigure & retrigger samp_chan when samp_chan finishes.
+    samp_chan = dma_claim_unused_channel(true); // samp_chan declared in header.
+    int ctrl_chan = dma_claim_unused_channel(true);
+    printf("Sample channel: %d\r\n", samp_chan);
+    printf("Ctrl channel: %d\r\n", ctrl_chan);
+    init_sample_channel(sample_count, fire_interrupt, ctrl_chan);
+    dma_channel_config ctrl_conf = dma_channel_get_default_config(ctrl_chan);
 
     // Setup Reconfiguration Channel
     // This channel will Write the starting address to the write address
@@ -124,3 +145,29 @@ void init_continuous_adc_sampling(uint8_t adc_pin_mask,
     adc_run(true); // Kick off the ADC in free-running mode.
     printf("Started adc.\r\n");
 }
+
+void init_triggered_adc_sampling(uint8_t adc_pin_mask, uint8_t sample_count)
+{
+    printf("Setting up triggered transfers of %d samples.\r\n",
+           sample_count);
+    init_adc(adc_pin_mask);
+    samp_chan = dma_claim_unused_channel(true);
+    printf("Sample channel: %d\r\n", samp_chan);
+    init_sample_channel(sample_count, false, samp_chan);
+    adc_run(true); // The FIFO overflows between transfers.
+    printf("Started adc.\r\n");
+}
+
+bool __time_critical_func(trigger_adc_sampling)(uint16_t* adc_samples_dest,
+                                                uint8_t sample_count)
+{
+    bool complete = (dma_channel_hw_addr(samp_chan)->transfer_count == 0);
+    dma_channel_abort(samp_chan);
+    // Discard conversions from before the trigger. The FIFO may also have
+    // overflowed while no transfer was running.
+    while (!adc_fifo_is_empty())
+        (void)adc_fifo_get();
+    dma_channel_transfer_to_buffer_now(samp_chan, adc_samples_dest,
+                                       sample_count);
+    return complete;
+}
@@ -5,36 +5,447 @@ uint32_t prev_print_time_ms;
 uint32_t curr_time_ms;
 uint32_t loop_start_cpu_cycle;
 uint32_t cpu_cycles;
+uint32_t max_cpu_cycles; // worst case since the last print.
 #endif
 
-// Location to write one period of the ADC samples to.
-uint16_t adc_vals[20] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+// Core1's data is kept together in the SCRATCH_X bank in CORE1_IN_SRAM builds.
 
-volatile bool update_due; // flag indicating lick detector fsm must update.
-                          // (Value changed inside an interrupt handler.)
-uint8_t lick_states; // bit fields represent the lick state of each detector.
-                     // This value is what is dispatched on a harp message.
-uint8_t new_lick_states;
-lick_event_t lick_event; // data to push into the queue upon detecting a lick
-                         // state change.
+// Location to write one period of the ADC samples to. Only the first
+// samples_per_period entries are used.
+uint16_t __core1_data("adc") adc_vals[ADS7049_MAX_SAMPLES_PER_PERIOD];
+
+// Flag indicating lick detector fsm must update.
+// (Value changed inside an interrupt handler.)
+volatile bool __core1_data("state") update_due;
+// Periods elapsed since the stream started.
+// (Value changed inside an interrupt handler.)
+volatile uint64_t __core1_data("state") sample_clock;
+uint64_t stream_start_time_us; // system time when sample_clock started.
+uint32_t sample_period_ns; // duration of one sample_clock tick.
+uint32_t sample_clock_rate_hz; // ADC samples per second.
+uint16_t sample_clock_samples_per_period; // ADC samples per tick.
+uint32_t __core1_data("state") sample_period_us; // rounded up.
+uint32_t ads7049_default_clkdiv; // PIO clkdiv register at ADC_SAMPLE_RATE_HZ.
+detector_settings_t detector_settings; // new settings received from core0.
+uint32_t last_update_time_us; // system time of the last period interrupt.
+uint32_t acquisition_timeout_us; // stream is stalled if exceeded.
+acquisition_fault_t acquisition_fault; // data to push into the queue upon
+                                       // recovering from a stall.
+// Bit fields represent the lick state of each detector.
+// This value is what is dispatched on a harp message.
+uint8_t __core1_data("state") lick_states;
+uint8_t __core1_data("state") new_lick_states;
+// Data to push into the queue upon detecting a lick state change.
+lick_event_t __core1_data("state") lick_event;
+uint16_t threshold_q16; // new threshold setting received from core0.
+proximity_thresholds_t proximity_thresholds; // new proximity thresholds
+                                             // received from core0.
+detection_mode_t detection_mode; // new detection mode received from core0.
+detector_stats_t detector_stats; // data to push into the queue periodically.
+uint32_t detector_stats_countdown; // periods until the next report.
+decimation_t decimation; // new decimation settings received from core0.
+uint8_t __core1_data("state") decimation_factor; // 1 disables decimation.
+uint8_t __core1_data("state") decimation_phase; // detectors may only skip
+                                                // periods when nonzero.
+// Bit fields represent which detectors just finished a contact this update.
+uint8_t __core1_data("state") stopped_detectors;
+// Data to push into the queue upon the end of a contact.
+lick_features_event_t __core1_data("state") lick_features_event;
 
 // Create instance for the ADS7049.
 PIO_ADS7049 ads7049_0(pio0, ADS7049_CS_PIN, ADS7049_SCK_PIN, ADS7049_POCI_PIN);
 
-// List of lick detectors (just 1 for now).
-//LickDetector __not_in_flash("instances")lick_detectors[1]
-LickDetector lick_detectors[1]
-    {{adc_vals, SAMPLES_PER_PERIOD, TTL_PIN, LED_PIN}};
-    // {adc2_vals, SAMPLES_PER_PERIOD, 13, 14}};
+#if defined(INTERNAL_ADC_CHANNEL)
+// The internal ADC fills one buffer per ADS7049 period while core1 processes
+// the other, which holds the period that just ended. Both are swapped on the
+// ADS7049 interrupt, so both channels measure the same period.
+// INTERNAL_ADC_PIN_MASK selects one input, so every sample is Channel1's.
+uint16_t __core1_data("adc") adc1_vals[2][INTERNAL_ADC_SAMPLES_PER_PERIOD];
+uint8_t __core1_data("adc") adc1_fill_index; // buffer being filled.
+// Samples per window: one 100KHz period, or as much of it as fits in the
+// ADS7049 period.
+uint8_t __core1_data("adc") adc1_samples_per_period =
+    INTERNAL_ADC_SAMPLES_PER_PERIOD;
+// False if the last period was shorter than the internal ADC's window, so
+// its buffer was only partly filled.
+volatile bool __core1_data("adc") adc1_vals_complete;
+#endif
+// Bit fields (in lick_states order) represent which detectors run.
+uint8_t __core1_data("state") enabled_detectors;
+// Bit fields represent which channels' estimators run.
+uint8_t __core1_data("state") enabled_channels;
+
+// One amplitude estimator per channel.
+AmplitudeEstimator __core1_data("instances") estimators[]
+    {{adc_vals, SAMPLES_PER_PERIOD}
+#if defined(INTERNAL_ADC_CHANNEL)
+    ,{adc1_vals[1], INTERNAL_ADC_SAMPLES_PER_PERIOD}
+#endif
+    };
+
+// List of lick detectors. Each reads one channel's estimator.
+LickDetector __core1_data("instances") lick_detectors[]
+    {{estimators[0], NO_PIN, LED_PIN} // TTL_PIN is PIO-driven.
+#if defined(INTERNAL_ADC_CHANNEL)
+    ,{estimators[1], NO_PIN, NO_PIN}
+#endif
+    ,{estimators[0], NO_PIN, NO_PIN, DEFAULT_PROXIMITY_ON_THRESHOLD_Q16,
+      DEFAULT_PROXIMITY_OFF_THRESHOLD_Q16, PROXIMITY_CONSENSUS_WINDOW,
+      PROXIMITY_HOLD_TIME_US}
+    };
+// lick_states bit of each detector, so that bits do not move between builds.
+const uint8_t __core1_data("instances") detector_state_bits[]
+    {CHANNEL0_STATE_BIT
+#if defined(INTERNAL_ADC_CHANNEL)
+    ,CHANNEL1_STATE_BIT
+#endif
+    ,PROXIMITY0_STATE_BIT
+    };
+// Number of detectors that measure contact (not proximity). They follow the
+// touch threshold registers.
+#if defined(INTERNAL_ADC_CHANNEL)
+#define TOUCH_DETECTOR_COUNT (2)
+#else
+#define TOUCH_DETECTOR_COUNT (1)
+#endif
+#define PROXIMITY0_DETECTOR (TOUCH_DETECTOR_COUNT)
+
+// PIO state machine that owns TTL_PIN and follows Channel0's lick state.
+TtlOutput __core1_data("instances") ttl_output(pio1, TTL_PIN);
+ttl_config_t ttl_config; // new TTL output settings received from core0.
+
+// Harp-clock schedule of the slots in which this board may excite.
+TimeDivision __core1_data("instances") time_division;
+time_division_t time_division_config; // new schedule received from core0.
+int64_t __core1_data("state") harp_offset_us; // Harp time minus system time.
+bool __core1_data("state") excitation_on;
+
+// Periods of raw samples copied out for core0's noise-floor monitor.
+noise_capture_t noise_capture;
+uint32_t noise_capture_countdown; // periods until the next capture starts.
+uint64_t noise_capture_last_period; // sample clock of the last copied period.
+
+// Raw samples and amplitudes around a trigger, for post-mortems.
+WaveformCapture waveform_capture;
+waveform_request_t waveform_request; // arm/trigger requests from core0.
+waveform_event_t waveform_event; // data to push into the queue upon
+                                 // finishing a snapshot.
+
+#if defined(AD9833_EXCITATION)
+// Create AD9833 instance and init underlying SPI hardware (default behavior).
+AD9833 ad9833(AD9833_MCLK_HZ, spi0, AD9833_SPI_TX_PIN, AD9833_SPI_RX_PIN,
+              AD9833_SPI_SCK_PIN, AD9833_SPI_CS_PIN);
+FrequencySweep frequency_sweep(ad9833);
+uint32_t excitation_freq_hz; // excitation frequency outside of a sweep.
+sweep_request_t sweep_request;
+sweep_result_t sweep_result;
+#endif
 
 void  __time_critical_func(flag_update)()
 {
     // Clear interrupt request.
     ads7049_0.clear_interrupt();
+#if defined(INTERNAL_ADC_CHANNEL)
+    // Latch the internal ADC's samples of the period that just ended.
+    adc1_vals_complete = trigger_adc_sampling(adc1_vals[adc1_fill_index ^ 1],
+                                              adc1_samples_per_period);
+    estimators[1].set_adc_vals(adc1_vals[adc1_fill_index]);
+    adc1_fill_index ^= 1;
+#endif
+    ++sample_clock;
     update_due = true;
 }
 
-void core1_main()
+void reset_sample_clock(size_t samples_per_period, uint32_t sample_rate_hz)
+{
+    // Events carry the samples and rate rather than the (truncated) period
+    // so that core0 can convert periods to time without drift.
+    sample_clock_rate_hz = sample_rate_hz;
+    sample_clock_samples_per_period = samples_per_period;
+    sample_period_ns = (uint64_t(samples_per_period) * 1000000000ull)
+                       / sample_rate_hz;
+    sample_period_us = (sample_period_ns + 999) / 1000;
+    acquisition_timeout_us = (uint64_t(sample_period_ns)
+                              * ACQUISITION_TIMEOUT_PERIODS) / 1000;
+    if (acquisition_timeout_us < ACQUISITION_MIN_TIMEOUT_US)
+        acquisition_timeout_us = ACQUISITION_MIN_TIMEOUT_US;
+    last_update_time_us = time_us_32();
+    stream_start_time_us = time_us_64();
+    sample_clock = 0;
+    // All detectors update on the same period interrupt.
+    for (uint8_t i = 0; i < count_of(lick_detectors); ++i)
+        lick_detectors[i].set_period_ns(sample_period_ns);
+}
+
+uint32_t set_ads7049_sample_rate(uint32_t sample_rate_hz)
+{
+    // clkdiv register holds a 16-bit integer [31:16] and 8-bit fraction
+    // [15:8]. Work in units of 1/256.
+    uint64_t default_div_256 = ads7049_default_clkdiv >> 8u;
+    uint64_t div_256 = (default_div_256 * ADC_SAMPLE_RATE_HZ
+                        + sample_rate_hz / 2) / sample_rate_hz;
+    if (div_256 < 256)
+        div_256 = 256;
+    if (div_256 > 0xFFFFFF)
+        div_256 = 0xFFFFFF;
+    pio_sm_set_clkdiv_int_frac(pio0, ADS7049_SM, div_256 >> 8u,
+                               div_256 & 0xFF);
+    return (default_div_256 * ADC_SAMPLE_RATE_HZ) / div_256;
+}
+
+void restart_ads7049_stream()
+{
+    ads7049_0.reset(); // Clear existing dma stream-to-memory config.
+    uint32_t sample_rate_hz =
+        set_ads7049_sample_rate(detector_settings.sample_rate_hz);
+#if defined(INTERNAL_ADC_CHANNEL)
+    // Fit the internal ADC's window in the new period.
+    uint64_t adc1_samples = (uint64_t(detector_settings.samples_per_period)
+                             * INTERNAL_ADC_SAMPLE_RATE_HZ) / sample_rate_hz;
+    adc1_samples_per_period = (adc1_samples < INTERNAL_ADC_SAMPLES_PER_PERIOD)?
+                              adc1_samples: INTERNAL_ADC_SAMPLES_PER_PERIOD;
+    estimators[1].set_samples_per_period(adc1_samples_per_period);
+#endif
+    ads7049_0.setup_dma_stream_to_memory_with_interrupt(
+        adc_vals, detector_settings.samples_per_period, DMA_IRQ_0,
+        flag_update);
+    reset_sample_clock(detector_settings.samples_per_period, sample_rate_hz);
+    update_due = false; // Clear update signal if it was previously set.
+    noise_capture.sample_count = 0; // Discard any partial capture.
+}
+
+void __core1_func(capture_noise_period)()
+{
+    if (noise_capture_countdown)
+    {
+        --noise_capture_countdown;
+        return;
+    }
+    size_t samples_per_period = detector_settings.samples_per_period;
+    uint64_t period = get_sample_clock();
+    // Periods must be back-to-back for the excitation to stay in phase.
+    // Start over if one was skipped.
+    if (noise_capture.sample_count && period != noise_capture_last_period + 1)
+        noise_capture.sample_count = 0;
+    if (noise_capture.sample_count == 0)
+    {
+        noise_capture.periods = NOISE_MAX_WINDOW_SAMPLES / samples_per_period;
+        if (noise_capture.periods < NOISE_MIN_WINDOW_PERIODS)
+        {
+            noise_capture_countdown = NOISE_CAPTURE_INTERVAL_PERIODS;
+            return; // Periods are too long to analyze.
+        }
+    }
+    for (size_t i = 0; i < samples_per_period; ++i)
+        noise_capture.samples[noise_capture.sample_count + i] = adc_vals[i];
+    noise_capture.sample_count += samples_per_period;
+    noise_capture_last_period = period;
+    if (noise_capture.sample_count < noise_capture.periods * samples_per_period)
+        return;
+    // Drop the capture if core0 hasn't finished with the last one.
+    if (queue_try_add(&noise_capture_queue, &noise_capture))
+        core0_doorbell = true;
+    noise_capture.sample_count = 0;
+    noise_capture_countdown = NOISE_CAPTURE_INTERVAL_PERIODS;
+}
+
+void __core1_func(trigger_waveform_capture)()
+{
+    if (waveform_capture.state() != WaveformCapture::ARMED)
+        return;
+    waveform_capture.trigger();
+    waveform_event.period = get_sample_clock();
+    waveform_event.stream_start_us = stream_start_time_us;
+    waveform_event.sample_rate_hz = sample_clock_rate_hz;
+    waveform_event.samples_per_period = sample_clock_samples_per_period;
+}
+
+void __core1_func(set_excitation)(bool enabled)
+{
+    if (enabled == excitation_on)
+        return;
+    excitation_on = enabled;
+#if defined(AD9833_EXCITATION)
+    if (enabled)
+        ad9833.enable_output();
+    else
+        ad9833.disable_output();
+#else
+    // Both square wave pins share a PWM slice, which core0 configures. Use
+    // the atomic aliases since core0 also writes to this register.
+    uint slice_num = pwm_gpio_to_slice_num(SQUARE_WAVE_PIN_100KHZ);
+    if (enabled)
+        hw_set_bits(&pwm_hw->slice[slice_num].csr, PWM_CH0_CSR_EN_BITS);
+    else
+        hw_clear_bits(&pwm_hw->slice[slice_num].csr, PWM_CH0_CSR_EN_BITS);
+#endif
+}
+
+void recover_acquisition()
+{
+    restart_ads7049_stream();
+    ads7049_0.start(); // In case the state machine itself stalled.
+    // Resetting clears detector outputs and restarts the filter warmup, which
+    // cannot trigger.
+    for (uint8_t i = 0; i < count_of(lick_detectors); ++i)
+        lick_detectors[i].reset();
+    ttl_output.reset();
+    // Release any licks in progress so the host's state stays consistent.
+    if (lick_states)
+    {
+        lick_states = 0;
+        lick_event.state = lick_states;
+        lick_event.period = get_sample_clock();
+        lick_event.stream_start_us = stream_start_time_us;
+        lick_event.sample_rate_hz = sample_clock_rate_hz;
+        lick_event.samples_per_period = sample_clock_samples_per_period;
+        queue_try_add(&lick_event_queue, &lick_event);
+    }
+    ++acquisition_fault.recovery_count;
+    acquisition_fault.time_us = stream_start_time_us;
+    queue_try_add(&acquisition_fault_queue, &acquisition_fault);
+    core0_doorbell = true;
+}
+
+uint64_t __core1_func(get_sample_clock)()
+{
+    uint64_t periods;
+    do
+        periods = sample_clock;
+    while (periods != sample_clock);
+    return periods;
+}
+
+void apply_core0_requests()
+{
+    // Check for new configuration settings (also applies a reset).
+    // Only the latest settings need to be applied.
+    bool new_settings = false;
+    while (queue_try_remove(&detector_settings_queue, &detector_settings))
+        new_settings = true;
+    if (new_settings)
+    {
+        uint8_t settings = detector_settings.settings;
+        size_t samples_per_period = detector_settings.samples_per_period;
+#if defined(AD9833_EXCITATION)
+        frequency_sweep.abort();
+        excitation_freq_hz = bool(settings & 0x01)? 100000: 125000;
+        ad9833.set_frequency_hz(excitation_freq_hz);
+#endif
+        // The internal ADC's window is set with the stream (see
+        // restart_ads7049_stream()).
+        estimators[0].set_samples_per_period(samples_per_period);
+        for (uint8_t i = 0; i < count_of(lick_detectors); ++i)
+            lick_detectors[i].reset();
+        waveform_capture.configure(samples_per_period); // Discards snapshot.
+        ttl_output.reset();
+        enabled_detectors = (1u << CHANNEL0_STATE_BIT)
+                            | (((settings >> 3u) & 0x01) << PROXIMITY0_STATE_BIT);
+        enabled_channels = 0x01;
+#if defined(INTERNAL_ADC_CHANNEL)
+        enabled_detectors |= ((settings >> 2u) & 0x01) << CHANNEL1_STATE_BIT;
+        enabled_channels |= ((settings >> 2u) & 0x01) << 1u;
+#endif
+        // Core0 may have just reconfigured (and enabled) the excitation.
+        excitation_on = false;
+        set_excitation(true);
+        restart_ads7049_stream();
+    }
+    // Check for new lick threshold settings.
+    while (queue_try_remove(&set_on_threshold_queue, &threshold_q16))
+    {
+        // All channels share the same threshold settings.
+        for (uint8_t i = 0; i < TOUCH_DETECTOR_COUNT; ++i)
+            lick_detectors[i].set_on_threshold_q16(threshold_q16);
+    }
+    while (queue_try_remove(&set_off_threshold_queue, &threshold_q16))
+    {
+        for (uint8_t i = 0; i < TOUCH_DETECTOR_COUNT; ++i)
+            lick_detectors[i].set_off_threshold_q16(threshold_q16);
+    }
+    while (queue_try_remove(&proximity_thresholds_queue,
+                            &proximity_thresholds))
+    {
+        lick_detectors[PROXIMITY0_DETECTOR].set_on_threshold_q16(
+            proximity_thresholds.on_threshold_q16);
+        lick_detectors[PROXIMITY0_DETECTOR].set_off_threshold_q16(
+            proximity_thresholds.off_threshold_q16);
+    }
+    while (queue_try_remove(&detection_mode_queue, &detection_mode))
+    {
+        // Proximity triggers on a shallower dip than touch.
+        lick_detectors[PROXIMITY0_DETECTOR].set_zscore_k_q4(
+            detection_mode.zscore_k_q4 >> 1);
+        for (uint8_t i = 0; i < count_of(lick_detectors); ++i)
+        {
+            if (i < TOUCH_DETECTOR_COUNT)
+                lick_detectors[i].set_zscore_k_q4(detection_mode.zscore_k_q4);
+            lick_detectors[i].set_detection_mode(
+                LickDetector::DetectionMode(detection_mode.mode),
+                detection_mode.cusum_threshold_q4);
+        }
+        // Start a fresh report for the new mode.
+        detector_stats_countdown = DETECTOR_STATS_INTERVAL_PERIODS;
+        detector_stats.processed_periods = 0;
+        detector_stats.skipped_periods = 0;
+    }
+    // Only the latest time division schedule needs to be applied.
+    bool new_time_division = false;
+    while (queue_try_remove(&time_division_queue, &time_division_config))
+        new_time_division = true;
+    if (new_time_division)
+    {
+        harp_offset_us = time_division_config.harp_offset_us;
+        time_division.configure(time_division_config.slot_count,
+                                time_division_config.board_index,
+                                time_division_config.slot_us);
+        if (!time_division.enabled())
+            set_excitation(true);
+    }
+    while (queue_try_remove(&decimation_queue, &decimation))
+    {
+        decimation_factor = decimation.factor;
+        decimation_phase = 0;
+        for (uint8_t i = 0; i < count_of(lick_detectors); ++i)
+            lick_detectors[i].set_guard_q16(decimation.guard_q16);
+    }
+    // Check for new TTL output settings. Only the latest need to be applied.
+    bool new_ttl_config = false;
+    while (queue_try_remove(&ttl_config_queue, &ttl_config))
+        new_ttl_config = true;
+    if (new_ttl_config)
+        ttl_output.set_config(ttl_config);
+    // Check for waveform capture requests.
+    while (queue_try_remove(&waveform_request_queue, &waveform_request))
+    {
+        if (waveform_request.state == WaveformCapture::ARMED)
+            waveform_capture.arm(waveform_request.pre_trigger_periods,
+                                 waveform_request.post_trigger_periods);
+        else if (waveform_request.state == WaveformCapture::TRIGGERED)
+            trigger_waveform_capture();
+        else
+            waveform_capture.disarm();
+    }
+#if defined(AD9833_EXCITATION)
+    // Check for frequency sweep requests.
+    while (queue_try_remove(&sweep_request_queue, &sweep_request))
+    {
+        if (sweep_request.start)
+            frequency_sweep.start(sweep_request.start_hz,
+                                  sweep_request.stop_hz,
+                                  excitation_freq_hz);
+        else if (frequency_sweep.is_running())
+        {
+            frequency_sweep.abort();
+            for (uint8_t i = 0; i < count_of(lick_detectors); ++i)
+                lick_detectors[i].reset();
+            ttl_output.reset();
+        }
+    }
+#endif
+}
+
+void __core1_func(core1_main)()
 {
 #ifdef PROFILE_CPU
     // Configure SYSTICK register to tick with cpu clock (125MHz) and enable it.
@@ -42,22 +453,56 @@ void core1_main()
     // init variable with valid states for periodic status printing.
     curr_time_ms = to_ms_since_boot(get_absolute_time());
     prev_print_time_ms = curr_time_ms;
+    max_cpu_cycles = 0;
 #endif
     // Setup starting state.
     update_due = false;
     lick_states = 0; // Start with no licks detected.
     new_lick_states = 0;
+    enabled_detectors = 1u << CHANNEL0_STATE_BIT;
+    enabled_channels = 0x01;
+    excitation_on = true; // Started by core0 (or below for the AD9833).
+    detector_settings.sample_rate_hz = ADC_SAMPLE_RATE_HZ;
+    detector_settings.samples_per_period = SAMPLES_PER_PERIOD;
+    acquisition_fault.recovery_count = 0;
+    noise_capture.sample_count = 0;
+    noise_capture_countdown = NOISE_CAPTURE_INTERVAL_PERIODS;
+    detector_stats_countdown = DETECTOR_STATS_INTERVAL_PERIODS;
+    detector_stats.processed_periods = 0;
+    detector_stats.skipped_periods = 0;
+    decimation_factor = 1;
+    decimation_phase = 0;
     // Send initial threshold settings to core0.
-    queue_try_add(&get_on_threshold_queue, &lick_detectors[0].on_threshold_percent_);
-    queue_try_add(&get_off_threshold_queue, &lick_detectors[0].off_threshold_percent_);
+    queue_try_add(&get_on_threshold_queue, &lick_detectors[0].on_threshold_q16_);
+    queue_try_add(&get_off_threshold_queue, &lick_detectors[0].off_threshold_q16_);
+    core0_doorbell = true;
+#if defined(AD9833_EXCITATION)
+    // All AD9833 writes from core1 are queued so that they never block.
+    ad9833.setup_dma_writes();
+    ad9833.disable_output(); // aka: reset.
+    excitation_freq_hz = 100000;
+    ad9833.set_frequency_hz(excitation_freq_hz);
+    ad9833.set_phase_raw(0);
+    ad9833.enable_with_waveform(AD9833::waveform_t::SINE);
+#endif
+    // Keep the divider the ADS7049 instance chose for ADC_SAMPLE_RATE_HZ so
+    // that other rates can be derived from it.
+    ads7049_default_clkdiv = pio0->sm[ADS7049_SM].clkdiv;
     // Note: the core that attaches interrupt is the core that will handle it.
     // Connect ads7049 dma stream interrupt handler to lick detector.
     ads7049_0.setup_dma_stream_to_memory_with_interrupt(
         adc_vals, SAMPLES_PER_PERIOD, DMA_IRQ_0, flag_update);
     // Setup other ads7049 instances here if they exist, but don't
     // enable interrupt since they all interrupt at once.
+#if defined(INTERNAL_ADC_CHANNEL)
+    // Internal ADC transfers are triggered by the ads7049 interrupt (see
+    // flag_update()), so they need no interrupt of their own.
+    init_triggered_adc_sampling(INTERNAL_ADC_PIN_MASK,
+                                INTERNAL_ADC_SAMPLES_PER_PERIOD);
+#endif
 
     // Launch periodic ADC sampling after core1 lick detectors are ready.
+    reset_sample_clock(SAMPLES_PER_PERIOD, ADC_SAMPLE_RATE_HZ);
     ads7049_0.start();
 
     // Main loop. Periodically update lick detectors, and dispatch any change
@@ -68,78 +513,207 @@ void core1_main()
     loop_start_cpu_cycle = SYST_CVR;
     curr_time_ms = to_ms_since_boot(get_absolute_time());
 #endif
-        // Check for new configuration settings (also applies a reset).
-        if (!queue_is_empty(&detector_settings_queue))
+        // Only touch the request queues (and their spin locks) when core0
+        // has published something.
+        if (core1_doorbell)
         {
-            uint8_t settings;
-            queue_remove_blocking(&detector_settings_queue, &settings);
-            size_t samples_per_period = bool(settings & 0x01)? 20: 16;
-            lick_detectors[0].reset(); lick_detectors[0].set_samples_per_period(samples_per_period);
-            ads7049_0.reset(); // Clear existing dma stream-to-memory config.
-            ads7049_0.setup_dma_stream_to_memory_with_interrupt(
-                adc_vals, samples_per_period, DMA_IRQ_0, flag_update);
-            update_due = false; // Clear update signal if it was previously set.
+            core1_doorbell = false; // Clear first so no request is missed.
+            apply_core0_requests();
         }
-        // Check for new lick threshold settings.
-        if (!queue_is_empty(&set_on_threshold_queue))
+#if defined(AD9833_EXCITATION)
+        ad9833.service(); // Launch any queued register writes.
+        // Lick detection is suspended while sweeping.
+        if (update_due && frequency_sweep.is_running())
         {
-            queue_remove_blocking(&set_on_threshold_queue,
-                                  &lick_detectors[0].on_threshold_percent_);
-        }
-        if (!queue_is_empty(&set_off_threshold_queue))
-        {
-            queue_remove_blocking(&set_off_threshold_queue,
-                                  &lick_detectors[0].off_threshold_percent_);
+            update_due = false; // Clear update flag.
+            last_update_time_us = time_us_32();
+            set_excitation(true); // Sweeps ignore the time division.
+            frequency_sweep.update(estimators[0].get_raw_amplitude());
+            if (frequency_sweep.sweep_finished())
+            {
+                frequency_sweep.clear_sweep_finished_flag();
+                for (uint8_t i = 0; i < SWEEP_STEP_COUNT; ++i)
+                    sweep_result.amplitudes[i] = frequency_sweep.amplitudes_[i];
+                queue_try_add(&sweep_result_queue, &sweep_result);
+                core0_doorbell = true;
+                // Baseline was measured at another frequency. Start over.
+                for (uint8_t i = 0; i < count_of(lick_detectors); ++i)
+                    lick_detectors[i].reset();
+                ttl_output.reset();
+            }
         }
+#endif
+        // Acquisition watchdog. Periods stop arriving if the ADS7049's
+        // PIO/DMA chain stalls.
+        if (!update_due
+            && (time_us_32() - last_update_time_us) > acquisition_timeout_us)
+            recover_acquisition();
         // Check if any licks were detected.
         // Timestamp them and queue a harp message.
         if (update_due) // All detectors due for update on the same schedule.
         {
             update_due = false; // Clear update flag.
+            last_update_time_us = time_us_32();
             new_lick_states = lick_states;
-            // Update lick detector finite state machine.
+            stopped_detectors = 0;
+            // Idle detectors only update every decimation_factor periods,
+            // unless raw waveforms (with amplitudes) are being recorded.
+            if (++decimation_phase >= decimation_factor)
+                decimation_phase = 0;
+            bool may_skip = decimation_phase
+                && waveform_capture.state() != WaveformCapture::ARMED
+                && waveform_capture.state() != WaveformCapture::TRIGGERED;
+            // Outside of this board's time division slot, turn off the
+            // excitation and hold every detector's state.
+            bool hold = false;
+            if (time_division.enabled())
+            {
+                time_division.update(time_us_64() + harp_offset_us);
+                set_excitation(time_division.excitation_enabled());
+                hold = !time_division.sampling(sample_period_us);
+            }
+            // Measure each enabled channel once, unless every detector
+            // reading it is idle.
+            for (uint8_t c = 0; c < count_of(estimators); ++c)
+            {
+                if (!(enabled_channels & (1u << c)))
+                    continue;
+                bool hold_channel = hold;
+#if defined(INTERNAL_ADC_CHANNEL)
+                // Rather than mix periods, hold Channel1 through periods that
+                // are shorter than the internal ADC's window.
+                hold_channel |= (c == 1) && !adc1_vals_complete;
+#endif
+                if (hold_channel)
+                {
+                    estimators[c].skip();
+                    continue;
+                }
+                if (may_skip && estimators[c].idle())
+                {
+                    estimators[c].skip();
+                    if (c == 0)
+                        ++detector_stats.skipped_periods;
+                    continue;
+                }
+                if (c == 0)
+                    ++detector_stats.processed_periods;
+                estimators[c].update();
+            }
+            // Update lick detector finite state machines.
             for (uint8_t i = 0; i < count_of(lick_detectors); ++i)
             {
+                uint8_t state_bit = 1u << detector_state_bits[i];
+                if (!(enabled_detectors & state_bit))
+                {
+                    new_lick_states &= ~state_bit; // clear bit field.
+                    continue;
+                }
+                if (lick_detectors[i].estimator().skipped())
+                    continue;
                 lick_detectors[i].update();
                 if (lick_detectors[i].lick_start_detected())
                 {
                     lick_detectors[i].clear_lick_detection_start_flag();
-                    new_lick_states |= 1u << i; // set bit field.
+                    new_lick_states |= state_bit; // set bit field.
+                    if (i == 0)
+                        ttl_output.lick_started();
                 }
                 else if (lick_detectors[i].lick_stop_detected())
                 {
                     lick_detectors[i].clear_lick_detection_stop_flag();
-                    new_lick_states &= ~(1u << i); // clear bit field.
+                    new_lick_states &= ~state_bit; // clear bit field.
+                    stopped_detectors |= 1u << i;
+                    if (i == 0)
+                        ttl_output.lick_stopped();
                 }
             }
+            // Cheap when not capturing: one decrement. The noise floor is
+            // only meaningful while exciting.
+            if (!hold)
+                capture_noise_period();
+            // Core0 turns these into an expected false alarm rate and
+            // reports how much work decimation saved.
+            if (--detector_stats_countdown == 0)
+            {
+                detector_stats_countdown = DETECTOR_STATS_INTERVAL_PERIODS;
+                detector_stats.cusum_drift = lick_detectors[0].cusum_drift();
+                detector_stats.cusum_limit = lick_detectors[0].cusum_limit();
+                detector_stats.noise_mad =
+                    lick_detectors[0].upscaled_noise_mad();
+                detector_stats.zscore_mean = lick_detectors[0].zscore_mean();
+                detector_stats.zscore_sigma = lick_detectors[0].zscore_sigma();
+                detector_stats.period_ns = sample_period_ns;
+                queue_try_add(&detector_stats_queue, &detector_stats);
+                core0_doorbell = true;
+                detector_stats.processed_periods = 0;
+                detector_stats.skipped_periods = 0;
+            }
+            // Record Channel0's raw period and freeze the capture around
+            // its lick onsets. Cheap when not armed: one comparison.
+            waveform_capture.push(adc_vals, estimators[0].raw_amplitude());
+            if ((new_lick_states & ~lick_states) & 0x01)
+                trigger_waveform_capture();
+            if (waveform_capture.capture_finished())
+            {
+                waveform_capture.clear_capture_finished_flag();
+                queue_try_add(&waveform_event_queue, &waveform_event);
+                core0_doorbell = true;
+            }
             // If previous lick detection state differs from the new one,
             // push the new state into the queue.
             if (new_lick_states != lick_states)
             {
                 lick_states = new_lick_states;
                 lick_event.state = lick_states;
-                lick_event.pico_time_us = time_us_64();
+                // Stamp with the sample clock. Core0 converts it to time.
+                lick_event.period = get_sample_clock();
+                lick_event.stream_start_us = stream_start_time_us;
+                lick_event.sample_rate_hz = sample_clock_rate_hz;
+                lick_event.samples_per_period = sample_clock_samples_per_period;
                 // Don't block if core0 is not responding, so TTL always works.
                 // FIXME: throw some sort of error if we fill up the queue.
                 queue_try_add(&lick_event_queue, &lick_event);
+                // Publish features of any finished contacts with the same
+                // timestamp.
+                for (uint8_t i = 0; stopped_detectors; ++i)
+                {
+                    if (!(stopped_detectors & (1u << i)))
+                        continue;
+                    stopped_detectors &= ~(1u << i);
+                    lick_features_event.channel = detector_state_bits[i];
+                    lick_features_event.period = lick_event.period;
+                    lick_features_event.stream_start_us = lick_event.stream_start_us;
+                    lick_features_event.sample_rate_hz = lick_event.sample_rate_hz;
+                    lick_features_event.samples_per_period =
+                        lick_event.samples_per_period;
+                    lick_features_event.features = lick_detectors[i].contact_features_;
+                    queue_try_add(&lick_features_queue, &lick_features_event);
+                }
+                core0_doorbell = true;
                 //printf("lick hist: %s\r\n",
                 //       lick_detectors[0].lick_history_.to_string().c_str());
             }
 #ifdef PROFILE_CPU
             cpu_cycles = loop_start_cpu_cycle - SYST_CVR; // SYSTICK counts down.
+            if (cpu_cycles > max_cpu_cycles)
+                max_cpu_cycles = cpu_cycles;
             // For debugging. Periodically print current measurements,
             // adc values, and cycles per loop.
             if (curr_time_ms - prev_print_time_ms >= PRINT_LOOP_INTERVAL_MS)
             {
                 prev_print_time_ms = curr_time_ms;
-                // Print CPU cycles per loop.
-                printf("core1 cycles/loop: %u\r\n", cpu_cycles);
+                // Print CPU cycles per loop and the worst case since the
+                // last print. Compare builds with and without CORE1_IN_SRAM.
+                printf("core1 cycles/loop: %u || max: %u\r\n", cpu_cycles,
+                       max_cpu_cycles);
+                max_cpu_cycles = 0;
 /*
                 // Print baseline and current amplitudes (both upscaled).
                 printf("amplitude: %08d || baseline: %08d || "
                        "cpu_cycles/loop: %u\r\n",
-                       lick_detectors[0].upscaled_amplitude_avg_,
-                       lick_detectors[0].upscaled_baseline_avg_,
+                       estimators[0].upscaled_amplitude_avg_,
+                       estimators[0].upscaled_baseline_avg_,
                        cpu_cycles);
 */
 /*
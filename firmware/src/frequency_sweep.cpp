@@ -0,0 +1,102 @@
+#include <frequency_sweep.h>
+
+FrequencySweep::FrequencySweep(AD9833& fn_gen)
+:fn_gen_{fn_gen}, state_{IDLE}, start_hz_{0}, stop_hz_{0}, restore_hz_{0},
+ step_index_{0}, period_count_{0}, amplitude_sum_{0},
+ sweep_finished_{false}
+{
+    for (size_t i = 0; i < SWEEP_STEP_COUNT; ++i)
+        amplitudes_[i] = 0;
+    log2_measure_periods_ = log2(SWEEP_MEASURE_PERIODS);
+}
+
+FrequencySweep::~FrequencySweep(){}
+
+void FrequencySweep::start(uint32_t start_hz, uint32_t stop_hz,
+                           uint32_t restore_hz)
+{
+    start_hz_ = start_hz;
+    stop_hz_ = stop_hz;
+    restore_hz_ = restore_hz;
+    step_index_ = 0;
+    sweep_finished_ = false;
+    for (size_t i = 0; i < SWEEP_STEP_COUNT; ++i)
+        amplitudes_[i] = 0;
+    start_step();
+}
+
+void FrequencySweep::abort()
+{
+    if (state_ == IDLE)
+        return;
+    fn_gen_.set_frequency_hz(restore_hz_);
+    state_ = IDLE;
+}
+
+uint32_t FrequencySweep::step_frequency_hz(size_t step_index)
+{
+    // Linear spacing. Signed math so that downward sweeps also work.
+    int64_t span_hz = int64_t(stop_hz_) - int64_t(start_hz_);
+    return uint32_t(int64_t(start_hz_)
+                    + (span_hz * int64_t(step_index)) / (SWEEP_STEP_COUNT - 1));
+}
+
+void FrequencySweep::start_step()
+{
+    // Queued write. Does not block.
+    fn_gen_.set_frequency_hz(step_frequency_hz(step_index_));
+    period_count_ = 0;
+    amplitude_sum_ = 0;
+    state_ = SETTLING;
+}
+
+void __core1_func(FrequencySweep::update)(uint32_t raw_amplitude)
+{
+    // Note: this function cannot block.
+    fn_gen_.service(); // Launch any queued frequency writes.
+    ++period_count_;
+    switch (state_)
+    {
+        case SETTLING:
+        {
+            // Don't count down the settling time until the new frequency
+            // has actually been written out.
+            if (fn_gen_.writes_pending())
+                period_count_ = 0;
+            if (period_count_ >= SWEEP_SETTLE_PERIODS)
+            {
+                period_count_ = 0;
+                state_ = MEASURING;
+            }
+            break;
+        }
+        case MEASURING:
+        {
+            amplitude_sum_ += raw_amplitude;
+            if (period_count_ < SWEEP_MEASURE_PERIODS)
+                break;
+            amplitudes_[step_index_] = amplitude_sum_ >> log2_measure_periods_;
+            ++step_index_;
+            if (step_index_ < SWEEP_STEP_COUNT)
+            {
+                start_step();
+                break;
+            }
+            // Sweep complete. Put the excitation frequency back.
+            fn_gen_.set_frequency_hz(restore_hz_);
+            state_ = RESTORING;
+            break;
+        }
+        case RESTORING:
+        {
+            // Finish once the original frequency has been written out.
+            if (fn_gen_.writes_pending())
+                break;
+            sweep_finished_ = true; // This flag must be cleared externally.
+            state_ = IDLE;
+            break;
+        }
+        default:
+            break;
+    }
+}
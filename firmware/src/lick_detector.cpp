@@ -1,112 +1,269 @@
 #include <lick_detector.h>
+#include <config.h>
 
-LickDetector::LickDetector(uint16_t* adc_vals, size_t samples_per_period,
-                           uint ttl_pin, uint led_pin, uint8_t on_threshold_percent,
-                           uint8_t off_threshold_percent)
-:adc_vals_{adc_vals},
- samples_per_period_{samples_per_period},
- state_{RESET},
+LickDetector::LickDetector(AmplitudeEstimator& estimator,
+                           uint ttl_pin, uint led_pin, uint16_t on_threshold_q16,
+                           uint16_t off_threshold_q16, size_t consensus_window,
+                           uint32_t hold_time_us)
+:on_threshold_q16_{on_threshold_q16},
+ off_threshold_q16_{off_threshold_q16},
+ estimator_{estimator},
  ttl_pin_{ttl_pin}, led_pin_{led_pin},
- on_threshold_percent_{on_threshold_percent},
- off_threshold_percent_{off_threshold_percent}
+ state_{RESET},
+ guard_q16_{DEFAULT_GUARD_Q16},
+ detection_mode_{CONSENSUS},
+ cusum_threshold_q4_{DEFAULT_CUSUM_THRESHOLD_Q4},
+ cusum_{0}, upscaled_noise_mad_{0},
+ zscore_k_q4_{DEFAULT_ZSCORE_K_Q4},
+ hold_time_us_{hold_time_us}
 {
+    output_mask_ = 0;
     // Init GPIO for TTL output.
-    gpio_init(ttl_pin_);
-    gpio_set_dir(ttl_pin_, true);  // true for output.
-    gpio_put(ttl_pin_, 0); // init output LOW.
+    if (ttl_pin_ != NO_PIN)
+    {
+        gpio_init(ttl_pin_);
+        gpio_set_dir(ttl_pin_, true);  // true for output.
+        gpio_put(ttl_pin_, 0); // init output LOW.
+        output_mask_ |= (1u << ttl_pin_);
+    }
     // Init LED pin for lick state.
-    gpio_init(led_pin_);
-    gpio_set_dir(led_pin_, true);  // true for output.
-    gpio_put(led_pin_, 0); // init output LOW.
-    // Pre-compute constants used in update loop.
-    // We will speed up multiplication-by-2 by converting it to bitshifts.
-    log2_upscale_factor_ = log2(UPSCALE_FACTOR);
-    log2_baseline_window_ = log2(BASELINE_AVG_WINDOW);
-    log2_moving_avg_window_ = log2(MOVING_AVG_WINDOW);
+    if (led_pin_ != NO_PIN)
+    {
+        gpio_init(led_pin_);
+        gpio_set_dir(led_pin_, true);  // true for output.
+        gpio_put(led_pin_, 0); // init output LOW.
+        output_mask_ |= (1u << led_pin_);
+    }
+    // Only the latest consensus_window periods of the history are compared.
+    if (consensus_window < 1)
+        consensus_window = 1;
+    consensus_mask_ = (consensus_window >= CONSENSUS_WINDOW)?
+                      ~0ull:
+                      (1ull << consensus_window) - 1;
+    trigger_history_ = 0;
+    reset_statistics();
+    set_period_ns((1000000000ul / ADC_SAMPLE_RATE_HZ) * SAMPLES_PER_PERIOD);
+}
+
+LickDetector::~LickDetector(){}
+
+void LickDetector::set_period_ns(uint32_t period_ns)
+{
+    // Convert hold time to periods.
+    hold_time_periods_ = (hold_time_us_ * 1000ul) / period_ns;
+}
+
+void LickDetector::set_on_threshold_q16(uint16_t on_threshold_q16)
+{
+    on_threshold_q16_ = on_threshold_q16;
+    update_thresholds();
+}
+
+void LickDetector::set_off_threshold_q16(uint16_t off_threshold_q16)
+{
+    off_threshold_q16_ = off_threshold_q16;
+    update_thresholds();
+}
+
+void LickDetector::set_guard_q16(uint16_t guard_q16)
+{
+    guard_q16_ = guard_q16;
+    update_thresholds();
+}
+
+void LickDetector::set_detection_mode(DetectionMode mode,
+                                      uint8_t cusum_threshold_q4)
+{
+    detection_mode_ = mode;
+    cusum_threshold_q4_ = cusum_threshold_q4;
+    cusum_ = 0;
+    upscaled_noise_mad_ = 0;
+    reset_statistics();
+    update_thresholds();
+}
+
+void LickDetector::set_zscore_k_q4(uint8_t k_q4)
+{
+    zscore_k_q4_ = k_q4;
+    update_thresholds();
 }
 
-uint32_t LickDetector::get_raw_amplitude()
+void LickDetector::reset_statistics()
 {
-    // Compute amplitude. Naive (but very fast) implementation.
-    uint32_t max = adc_vals_[0];
-    uint32_t min = adc_vals_[0];
-    for (uint8_t i = 0; i < samples_per_period_; ++i)
+    zscore_count_ = 0;
+    upscaled_mean_q16_ = 0;
+    upscaled_variance_q16_ = 0;
+    upscaled_sigma_ = 0;
+}
+
+float LickDetector::cusum_average_run_length(uint32_t cusum_drift,
+                                             uint32_t cusum_limit,
+                                             uint32_t upscaled_noise_mad)
+{
+    if (upscaled_noise_mad == 0)
+        return 0;
+    // Gaussian sigma from the mean absolute deviation. The moving average
+    // correlates consecutive amplitudes, which inflates the variance of
+    // their sum (what the CUSUM accumulates) by 2*MOVING_AVG_WINDOW - 1.
+    float sigma = 1.2533f * upscaled_noise_mad
+                  * sqrtf(2.f * MOVING_AVG_WINDOW - 1.f);
+    // Increments are (deficit - drift), with mean -drift without a contact.
+    float delta = float(cusum_drift) / sigma;
+    float b = float(cusum_limit) / sigma + 1.166f;
+    if (delta == 0)
+        return b * b;
+    float x = 2.f * delta * b;
+    if (x > 80.f) // Beyond float range. False alarms never happen.
+        return INFINITY;
+    return (expf(x) - x - 1.f) / (2.f * delta * delta);
+}
+
+/**
+ * \brief integer square root (rounded down), one result bit per iteration.
+ */
+static inline uint32_t isqrt(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1ul << 30;
+    while (bit > value)
+        bit >>= 2;
+    while (bit)
     {
-        if (adc_vals_[i] < min)
-            min = adc_vals_[i];
-        if (adc_vals_[i] > max)
-            max = adc_vals_[i];
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return root;
+}
+
+void __core1_func(LickDetector::update_thresholds)()
+{
+    // 64-bit math since the product exceeds 32 bits. This is slow on the M0+
+    // but only runs when the baseline or settings change.
+    uint32_t upscaled_baseline_avg = estimator_.upscaled_baseline_avg();
+    if (detection_mode_ == ZSCORE && zscore_valid())
+    {
+        upscaled_sigma_ = isqrt(uint32_t(upscaled_variance_q16_ >> 16));
+        if (upscaled_sigma_ < ZSCORE_MIN_SIGMA)
+            upscaled_sigma_ = ZSCORE_MIN_SIGMA;
+        uint32_t mean = uint32_t(upscaled_mean_q16_ >> 16);
+        uint32_t on_offset = (upscaled_sigma_ * zscore_k_q4_) >> 4;
+        uint32_t off_offset = on_offset >> 1;
+        on_threshold_ = (mean > on_offset)? mean - on_offset: 0;
+        off_threshold_ = (mean > off_offset)? mean - off_offset: 0;
+    }
+    else
+    {
+        on_threshold_ = (uint64_t(on_threshold_q16_) * upscaled_baseline_avg)
+                        >> 16;
+        off_threshold_ = (uint64_t(off_threshold_q16_) * upscaled_baseline_avg)
+                         >> 16;
     }
-    return max - min;
+    guard_threshold_ = (uint64_t(guard_q16_) * upscaled_baseline_avg) >> 16;
+    if (guard_threshold_ < on_threshold_)
+        guard_threshold_ = on_threshold_;
+    // CUSUM is referenced to the on-threshold deficit.
+    uint32_t on_deficit = (upscaled_baseline_avg > on_threshold_)?
+                          upscaled_baseline_avg - on_threshold_: 0;
+    cusum_drift_ = on_deficit >> 1;
+    cusum_limit_ = (on_deficit * cusum_threshold_q4_) >> 4;
 }
 
-void LickDetector::update_measurement_moving_avg()
+void __core1_func(LickDetector::update_cusum)()
 {
-    // Moving average is basically an IIR filter.
-    // Example for window size of 16:
-    // avg[i] = 15/16 * avg[i-1] + 1/16 * sample[i]
-    //upscaled_amplitude_avg_ = (((MOVING_AVG_WINDOW-1) * upscaled_amplitude_avg_)
-    upscaled_amplitude_avg_ = (__mul_instruction((MOVING_AVG_WINDOW-1),
-                                                 upscaled_amplitude_avg_)
-                               >> log2_moving_avg_window_)
-                          + (upscaled_amplitude_ >> log2_moving_avg_window_);
+    int32_t deficit = int32_t(estimator_.upscaled_baseline_avg())
+                      - int32_t(estimator_.upscaled_amplitude_avg());
+    int32_t cusum = int32_t(cusum_) + deficit - int32_t(cusum_drift_);
+    cusum_ = (cusum > 0)? cusum: 0;
+    // Moving average of the absolute deviation (an IIR filter, like the
+    // amplitude averages).
+    uint32_t deviation = (deficit < 0)? -deficit: deficit;
+    upscaled_noise_mad_ = upscaled_noise_mad_
+                          - (upscaled_noise_mad_ >> LOG2_NOISE_MAD_WINDOW)
+                          + (deviation >> LOG2_NOISE_MAD_WINDOW);
 }
 
-void LickDetector::update_baseline_moving_avg()
+void __core1_func(LickDetector::update_statistics)()
 {
-    //upscaled_baseline_avg_ = (((BASELINE_AVG_WINDOW-1) * upscaled_baseline_avg_)
-    upscaled_baseline_avg_ = (__mul_instruction((BASELINE_AVG_WINDOW-1),
-                                                upscaled_baseline_avg_)
-                              >> log2_baseline_window_)
-                            + (upscaled_amplitude_ >> log2_baseline_window_);
+    uint32_t upscaled_amplitude_avg = estimator_.upscaled_amplitude_avg();
+    // Keep (possible) contacts out of the statistics.
+    if (upscaled_amplitude_avg < on_threshold_)
+        return;
+    if (zscore_count_ == 0)
+    {
+        upscaled_mean_q16_ = int64_t(upscaled_amplitude_avg) << 16;
+        upscaled_variance_q16_ = 0;
+        zscore_count_ = 1;
+        return;
+    }
+    bool saturated = zscore_count_ == (1ul << LOG2_ZSCORE_WINDOW);
+    if (!saturated)
+        ++zscore_count_;
+    int32_t count = zscore_count_;
+    // Welford's update:
+    // mean[n] = mean[n-1] + (x - mean[n-1]) / n
+    // var[n] = var[n-1] + ((x - mean[n-1]) * (x - mean[n]) - var[n-1]) / n
+    // Deviations are clipped so the product fits in 32 bits. Dividing by a
+    // saturated count is an exact shift. Otherwise the hardware divider
+    // provides the quotient and the remainder is kept as a Q16 fraction.
+    int32_t deviation = int32_t(upscaled_amplitude_avg)
+                        - int32_t(upscaled_mean_q16_ >> 16);
+    if (deviation > ZSCORE_MAX_DEVIATION)
+        deviation = ZSCORE_MAX_DEVIATION;
+    if (deviation < -ZSCORE_MAX_DEVIATION)
+        deviation = -ZSCORE_MAX_DEVIATION;
+    upscaled_mean_q16_ += saturated?
+        int64_t(deviation) * (1l << (16 - LOG2_ZSCORE_WINDOW)):
+        int64_t((deviation * 65536) / count);
+    int32_t new_deviation = int32_t(upscaled_amplitude_avg)
+                            - int32_t(upscaled_mean_q16_ >> 16);
+    if (new_deviation > ZSCORE_MAX_DEVIATION)
+        new_deviation = ZSCORE_MAX_DEVIATION;
+    if (new_deviation < -ZSCORE_MAX_DEVIATION)
+        new_deviation = -ZSCORE_MAX_DEVIATION;
+    int32_t variance_step = deviation * new_deviation
+                            - int32_t(upscaled_variance_q16_ >> 16);
+    if (saturated)
+        upscaled_variance_q16_ += int64_t(variance_step)
+                                  * (1l << (16 - LOG2_ZSCORE_WINDOW));
+    else
+        upscaled_variance_q16_ += int64_t(variance_step / count) * 65536
+                                  + ((variance_step % count) * 65536) / count;
 }
 
-void LickDetector::update()
+void __core1_func(LickDetector::update)()
 {
     // Note: this function must only work with integer math!
     // Note: this function cannot block.
-    // Update state-agnostic logic.
-    uint32_t curr_time_ms = to_ms_since_boot(get_absolute_time());
-    // Update counter for baseline measurement.
-    sample_count_ = (sample_count_ == BASELINE_SAMPLE_INTERVAL)?
-                    0:
-                    ++sample_count_;
-    // Take raw measurement.
-    // If we want to reject spurious noise that is 3-4x larger than the original
-    // signal, we could do that here.
-    raw_amplitude_ = get_raw_amplitude();
-    // Update primary amplitude measurement.
-    upscaled_amplitude_ = raw_amplitude_ << log2_upscale_factor_;
+    // The estimator has already measured this period.
+    uint32_t period_count = estimator_.period_count();
+    uint32_t upscaled_amplitude_avg = estimator_.upscaled_amplitude_avg();
     // Update state-dependent internal/output logic.
-    // Update latest measurements (as long as fsm was not freshly reset).
     if (state_ != RESET)
     {
-        update_measurement_moving_avg();
-        // Update baseline setpoint on slow timescale (also upscale & average).
-        // TODO: possibly remove the state check.
-        if (sample_count_ == 0)/// && state_ != TRIGGERED)
-            update_baseline_moving_avg();
+        if (estimator_.baseline_updated())
+            update_thresholds();
     }
     else // Reset state conditions. We only land in the RESET state for 1 cycle.
     {
-        // Reset IIR filters.
-        // Set starting values for baseline
-        // "Not Licking" signal (super slow moving average w/ big window) &
-        // current sample signal (fast moving average w/ small window).
-        // Values cannot be initialized to 0, or the filters will take longer
-        // to "charge" to the approximate actual value on startup.
-        upscaled_amplitude_avg_ = upscaled_amplitude_;
-        upscaled_baseline_avg_ = upscaled_amplitude_;
+        // The estimator reseeded its filters with this period's amplitude.
+        reset_statistics();
+        update_thresholds();
         // Reset outputs and internal state logic.
-        gpio_put_masked((1u << ttl_pin_) | (1u << led_pin_), 0);
-        sample_count_ = 0;
+        gpio_put_masked(output_mask_, 0);
         lick_start_detected_ = false;
         lick_stop_detected_ = false;
         warmup_iterations_ = 0;
         hysteresis_elapsed_ = false;
-        trigger_history_.reset();
-        detection_start_time_ms_ = curr_time_ms;
-        detection_stop_time_ms_ = curr_time_ms;
+        trigger_history_ = 0;
+        cusum_ = 0;
+        detection_start_period_ = period_count;
+        detection_stop_period_ = period_count;
     }
     if (state_ == WARMUP)
     {
@@ -114,30 +271,37 @@ void LickDetector::update()
     }
     if (state_ == TRIGGERED)
     {
-        hysteresis_elapsed_ = (curr_time_ms - detection_start_time_ms_)
-                              > LICK_HOLD_TIME_MS;
+        hysteresis_elapsed_ = (period_count - detection_start_period_)
+                              > hold_time_periods_;
+        // Track contact depth and integrated deficit.
+        if (upscaled_amplitude_avg < contact_features_.upscaled_min_amplitude)
+            contact_features_.upscaled_min_amplitude = upscaled_amplitude_avg;
+        if (upscaled_amplitude_avg < contact_features_.upscaled_baseline)
+            contact_features_.upscaled_deficit +=
+                contact_features_.upscaled_baseline - upscaled_amplitude_avg;
     }
     if (state_ == UNTRIGGERED)
     {
-        hysteresis_elapsed_ = (curr_time_ms - detection_stop_time_ms_)
-                              > LICK_HOLD_TIME_MS;
+        hysteresis_elapsed_ = (period_count - detection_stop_period_)
+                              > hold_time_periods_;
+        if (detection_mode_ == CUSUM)
+            update_cusum();
+        else if (detection_mode_ == ZSCORE)
+            update_statistics();
     }
-    // Recompute trigger thresholds based on current baseline measurement and
-    // current threshold percentage settings.
-    uint32_t on_threshold = __mul_instruction((uint32_t)on_threshold_percent_,
-                                              upscaled_baseline_avg_) / 100;
-    uint32_t off_threshold = __mul_instruction((uint32_t)off_threshold_percent_,
-                                               upscaled_baseline_avg_) / 100;
     if (state_ & ~(RESET | WARMUP))
     {
-        // The current on/off threshold must be computed first.
-        // Update lick history.
+        // Update lick history. Below the on-threshold counts toward a
+        // trigger. Once triggered, anything below the off-threshold holds it.
+        uint32_t threshold = (state_ == TRIGGERED)? off_threshold_:
+                                                    on_threshold_;
         trigger_history_ <<= 1;
-        if (upscaled_amplitude_avg_ < on_threshold)
-            trigger_history_[0] = 1;
-        else if (upscaled_amplitude_avg_ > off_threshold)
-            trigger_history_[0] = 0;
+        if (upscaled_amplitude_avg < threshold)
+            trigger_history_ |= 1;
     }
+    bool all_triggered = (trigger_history_ & consensus_mask_)
+                         == consensus_mask_;
+    bool none_triggered = (trigger_history_ & consensus_mask_) == 0;
     // Compute next-state logic.
     State next_state{state_};  // Next state candidate initialized to curr state.
     switch (state_)
@@ -157,13 +321,16 @@ void LickDetector::update()
         }
         case UNTRIGGERED:
         {
-            if (trigger_history_.all() && hysteresis_elapsed_)
+            bool onset = (detection_mode_ == CUSUM)?
+                         cusum_ > cusum_limit_:
+                         all_triggered;
+            if (onset && hysteresis_elapsed_)
                 next_state = TRIGGERED;
             break;
         }
         case TRIGGERED:
         {
-            if (trigger_history_.none() && hysteresis_elapsed_)
+            if (none_triggered && hysteresis_elapsed_)
                 next_state = UNTRIGGERED;
             break;
         }
@@ -174,17 +341,25 @@ void LickDetector::update()
     // state-transition outputs:
     if (state_ == UNTRIGGERED && next_state == TRIGGERED)
     {
-        detection_start_time_ms_ = curr_time_ms;
+        detection_start_period_ = period_count;
+        contact_features_.upscaled_baseline = estimator_.upscaled_baseline_avg();
+        contact_features_.upscaled_min_amplitude = upscaled_amplitude_avg;
+        contact_features_.upscaled_deficit = 0;
+        cusum_ = 0; // Accumulate from scratch for the next contact.
         lick_start_detected_ = true; // This flag must be cleared externally.
-        gpio_put_masked((1u << ttl_pin_) | (1u << led_pin_),
-                        (1u << ttl_pin_) | (1u << led_pin_));
+        gpio_put_masked(output_mask_, output_mask_);
     }
     if (state_ == TRIGGERED && next_state == UNTRIGGERED)
     {
-        detection_stop_time_ms_ = curr_time_ms;
+        detection_stop_period_ = period_count;
+        contact_features_.duration_periods = period_count
+                                             - detection_start_period_;
         lick_stop_detected_ = true; // This flag must be cleared externally.
-        gpio_put_masked((1u << ttl_pin_) | (1u << led_pin_), 0);
+        gpio_put_masked(output_mask_, 0);
     }
     // Apply state transition.
     state_ = next_state;
+    // Keep the shared estimator at full rate unless this detector can wait.
+    if (!idle())
+        estimator_.require_full_rate();
 }
@@ -0,0 +1,37 @@
+#include <lick_history.h>
+
+LickHistory::LickHistory()
+:count_{0}
+{}
+
+LickHistory::~LickHistory(){}
+
+void LickHistory::push(uint8_t state, uint64_t harp_time_us)
+{
+    size_t index = count_ & (LICK_HISTORY_SIZE - 1);
+    harp_times_us_[index] = harp_time_us;
+    states_[index] = state;
+    ++count_;
+}
+
+void LickHistory::copy_window(uint32_t start_seq, uint64_t* harp_times_us,
+                              uint8_t* states, size_t window_size)
+{
+    // Oldest sequence number still in the ring.
+    uint32_t oldest_seq = (count_ > LICK_HISTORY_SIZE)?
+                          count_ - LICK_HISTORY_SIZE:
+                          0;
+    for (size_t i = 0; i < window_size; ++i)
+    {
+        uint32_t seq = start_seq + i;
+        if (seq < oldest_seq || seq >= count_)
+        {
+            harp_times_us[i] = 0;
+            states[i] = LICK_HISTORY_INVALID_STATE;
+            continue;
+        }
+        size_t index = seq & (LICK_HISTORY_SIZE - 1);
+        harp_times_us[i] = harp_times_us_[index];
+        states[i] = states_[index];
+    }
+}
@@ -11,6 +11,9 @@
 #include <harp_core.h>
 #include <harp_c_app.h>
 #include <harp_synchronizer.h>
+#include <lick_history.h>
+#include <noise_monitor.h>
+#include <time_division.h>
 #include <hardware/structs/bus_ctrl.h>
 
 // Harp App Setup.
@@ -22,17 +25,65 @@ const uint16_t serial_number = 0;
 
 // Create harp state queue for communication across cores.
 lick_event_t new_lick_state;
+lick_features_event_t new_lick_features;
 
 queue_t lick_event_queue;
+queue_t lick_features_queue;
 queue_t set_on_threshold_queue;
 queue_t set_off_threshold_queue;
 queue_t get_on_threshold_queue;
 queue_t get_off_threshold_queue;
 queue_t detector_settings_queue;
+queue_t detection_mode_queue;
+queue_t decimation_queue;
+queue_t proximity_thresholds_queue;
+queue_t time_division_queue;
+queue_t detector_stats_queue;
+queue_t sweep_request_queue;
+queue_t sweep_result_queue;
+queue_t ttl_config_queue;
+queue_t acquisition_fault_queue;
+queue_t noise_capture_queue;
+queue_t waveform_request_queue;
+queue_t waveform_event_queue;
+volatile bool core0_doorbell;
+volatile bool core1_doorbell;
+
+sweep_request_t new_sweep_request;
+sweep_result_t new_sweep_result;
+detector_settings_t new_detector_settings; // last settings committed to core1.
+detection_mode_t new_detection_mode;
+decimation_t new_decimation;
+proximity_thresholds_t new_proximity_thresholds;
+time_division_t new_time_division;
+detector_stats_t new_detector_stats;
+acquisition_fault_t new_acquisition_fault;
+ttl_config_t new_ttl_config;
+noise_capture_t new_noise_capture;
+waveform_request_t new_waveform_request;
+waveform_event_t new_waveform_event;
+
+// Record of recent lick events that the host can read back.
+LickHistory lick_history;
+
+// Background estimate of the excitation's SNR from core1's raw captures.
+NoiseMonitor noise_monitor;
 
 bool first_reset;
 uint pwm_slice_num;
 
+// Settings writes are staged and applied together, so a burst of writes costs
+// one detector reset (and warmup).
+#define SETTINGS_COMMIT_WINDOW_US (5000) // Staged settings are applied this
+                                         // long after the last write.
+bool detector_settings_pending;
+bool ttl_config_pending;
+bool sample_rate_or_settings_staged; // Settings or SampleRate written.
+bool samples_per_period_staged; // SamplesPerPeriod written.
+uint64_t settings_commit_time_us;
+uint8_t applied_signal_chain; // settings bits [1:0] that the analog
+                              // front-end is configured for.
+
 void set_led_state(bool enabled)
 {
     if (enabled)
@@ -46,7 +97,15 @@ void set_led_state(bool enabled)
 }
 
 // Setup for Harp App
-const size_t reg_count = 4;
+const size_t reg_count = 47;
+
+// Frequency sweep states reported in the sweep_state register.
+enum sweep_state_t: uint8_t
+{
+    SWEEP_IDLE = 0,
+    SWEEP_RUNNING = 1,
+    SWEEP_DONE = 2
+};
 
 // Define Harp app registers.
 #pragma pack(push, 1)
@@ -59,8 +118,106 @@ struct app_regs_t
                       //      1 ? --> 100KHz detection signal frequency
                       // [1]: 0 ? --> 2Vpp detection signal amplitude
                       //      1 ? --> 20mVpp detection signal amplitude
+                      // [2]: 1 ? --> enable Channel1 (internal ADC) lick
+                      //              detector (INTERNAL_ADC_CHANNEL builds).
+                      // [3]: 1 ? --> enable Channel0's proximity detector
+                      //              (Proximity0 lick state bit).
                       // Note: writing to this register will reset the lick
                       //       detector with the written settings.
+    uint32_t sweep_start_hz; // app register 4
+    uint32_t sweep_stop_hz; // app register 5
+    uint8_t sweep_state; // app register 6. Write 1 to start a sweep; write 0
+                         // to abort one. Reads back a sweep_state_t.
+    uint16_t sweep_amplitudes[SWEEP_STEP_COUNT]; // app register 7
+    uint32_t lick_history_count; // app register 8. Sequence number of the
+                                 // next lick event.
+    uint32_t lick_history_read_start; // app register 9. Writing a sequence
+                                      // number loads the window registers.
+    uint64_t lick_history_timestamps[LICK_HISTORY_WINDOW_SIZE]; // app register 10
+    uint8_t lick_history_states[LICK_HISTORY_WINDOW_SIZE]; // app register 11
+    uint16_t on_threshold_q16; // app register 12. Q16 fraction of baseline.
+                               // Same setting as on_threshold.
+    uint16_t off_threshold_q16; // app register 13. Q16 fraction of baseline.
+                                // Same setting as off_threshold.
+    uint32_t lick_features[4]; // app register 14. Features of the last
+                               // contact, emitted when it ends:
+                               // [0]: channel
+                               // [1]: duration [us]
+                               // [2]: depth (Q16 fraction of baseline)
+                               // [3]: integrated deficit [ADC counts * us]
+    uint8_t ttl_mode; // app register 15. A TtlOutput::Mode.
+    uint16_t ttl_pulse_width_us; // app register 16
+    uint16_t ttl_pulse_period_us; // app register 17. Pulse train only.
+    uint8_t ttl_pulse_count; // app register 18. Pulse train only.
+    uint16_t ttl_bout_gap_ms; // app register 19. One-shot-per-bout only.
+    uint32_t sample_rate_hz; // app register 20. ADS7049 sample rate.
+    uint16_t samples_per_period; // app register 21. Samples per lick
+                                 // detector update. At least one excitation
+                                 // period. Writing settings or
+                                 // sample_rate_hz resets it to one excitation
+                                 // period unless it is written in the same
+                                 // burst.
+    uint32_t acquisition_recoveries; // app register 22. Number of times the
+                                     // stalled ADC stream was restarted.
+    uint8_t settings_apply; // app register 23. Reads 1 while settings writes
+                            // are staged. Write 1 to apply them now instead
+                            // of SETTINGS_COMMIT_WINDOW_US after the last one.
+    uint16_t noise_snr_db_x10; // app register 24. Excitation power over the
+                               // off-excitation noise floor [0.1dB].
+    uint8_t noise_interference; // app register 25. 1 while the SNR is below
+                                // NOISE_INTERFERENCE_SNR_DB_X10. Emitted
+                                // when it changes.
+    uint8_t waveform_state; // app register 26. A WaveformCapture::State.
+                            // Write ARMED to start recording, TRIGGERED to
+                            // trigger an armed capture now, or IDLE to stop.
+                            // Also triggered by Channel0 lick onsets.
+    uint16_t waveform_pre_trigger; // app register 27. Periods kept before the
+                                   // trigger period.
+    uint16_t waveform_post_trigger; // app register 28. Periods recorded after
+                                    // the trigger period.
+    uint32_t waveform_info[4]; // app register 29. Layout of the snapshot,
+                               // emitted with waveform_state once ready:
+                               // [0]: samples per period
+                               // [1]: periods in the snapshot
+                               // [2]: index of the trigger period
+                               // [3]: period [ns]
+    uint32_t waveform_read_start; // app register 30. Writing a sample offset
+                                  // loads waveform_samples.
+    uint16_t waveform_samples[WAVEFORM_WINDOW_SIZE]; // app register 31
+    uint32_t waveform_amplitude_read_start; // app register 32. Writing a
+                                            // period offset loads
+                                            // waveform_amplitudes.
+    uint16_t waveform_amplitudes[WAVEFORM_WINDOW_SIZE]; // app register 33
+    uint8_t detection_mode; // app register 34. A LickDetector::DetectionMode.
+    uint8_t cusum_threshold_q4; // app register 35. CUSUM decision limit in
+                                // on-threshold deficits (Q4: 16 = 1x).
+    float cusum_false_alarm_rate; // app register 36. Expected false alarms
+                                  // per hour in CUSUM mode (0 until
+                                  // measured).
+    uint8_t decimation_factor; // app register 37. Idle detectors update every
+                               // decimation_factor periods (1: disabled).
+    uint16_t decimation_guard_q16; // app register 38. Detectors are idle
+                                   // above this Q16 fraction of baseline.
+    uint32_t processing_counts[2]; // app register 39. Channel0 periods in
+                                   // the last second:
+                                   // [0]: updated (full rate)
+                                   // [1]: skipped (idle)
+    uint16_t proximity_on_threshold_q16; // app register 40. Q16 fraction of
+                                         // baseline.
+    uint16_t proximity_off_threshold_q16; // app register 41. Q16 fraction of
+                                          // baseline.
+    uint8_t zscore_k_q4; // app register 42. ZSCORE mode on-threshold in
+                         // standard deviations below the mean (Q4: 16 = 1).
+    float zscore_statistics[2]; // app register 43. Channel0's amplitude
+                                // statistics in ZSCORE mode [ADC counts]
+                                // (0 until measured):
+                                // [0]: mean
+                                // [1]: standard deviation
+    uint8_t time_division_slots; // app register 44. Slots in the Harp-time
+                                 // excitation schedule shared by the boards
+                                 // in a rig. 0 or 1 disables it.
+    uint8_t time_division_index; // app register 45. This board's slot.
+    uint16_t time_division_slot_us; // app register 46. Slot duration.
     // FIXME: add a "busy" register.
 } app_regs;
 #pragma pack(pop)
@@ -71,14 +228,61 @@ RegSpecs app_reg_specs[reg_count]
     {(uint8_t*)&app_regs.lick_state, sizeof(app_regs.lick_state), U8},
     {(uint8_t*)&app_regs.on_threshold, sizeof(app_regs.on_threshold), U8},
     {(uint8_t*)&app_regs.off_threshold, sizeof(app_regs.off_threshold), U8},
-    {(uint8_t*)&app_regs.settings, sizeof(app_regs.settings), U8}
+    {(uint8_t*)&app_regs.settings, sizeof(app_regs.settings), U8},
+    {(uint8_t*)&app_regs.sweep_start_hz, sizeof(app_regs.sweep_start_hz), U32},
+    {(uint8_t*)&app_regs.sweep_stop_hz, sizeof(app_regs.sweep_stop_hz), U32},
+    {(uint8_t*)&app_regs.sweep_state, sizeof(app_regs.sweep_state), U8},
+    {(uint8_t*)&app_regs.sweep_amplitudes, sizeof(app_regs.sweep_amplitudes), U16},
+    {(uint8_t*)&app_regs.lick_history_count, sizeof(app_regs.lick_history_count), U32},
+    {(uint8_t*)&app_regs.lick_history_read_start, sizeof(app_regs.lick_history_read_start), U32},
+    {(uint8_t*)&app_regs.lick_history_timestamps, sizeof(app_regs.lick_history_timestamps), U64},
+    {(uint8_t*)&app_regs.lick_history_states, sizeof(app_regs.lick_history_states), U8},
+    {(uint8_t*)&app_regs.on_threshold_q16, sizeof(app_regs.on_threshold_q16), U16},
+    {(uint8_t*)&app_regs.off_threshold_q16, sizeof(app_regs.off_threshold_q16), U16},
+    {(uint8_t*)&app_regs.lick_features, sizeof(app_regs.lick_features), U32},
+    {(uint8_t*)&app_regs.ttl_mode, sizeof(app_regs.ttl_mode), U8},
+    {(uint8_t*)&app_regs.ttl_pulse_width_us, sizeof(app_regs.ttl_pulse_width_us), U16},
+    {(uint8_t*)&app_regs.ttl_pulse_period_us, sizeof(app_regs.ttl_pulse_period_us), U16},
+    {(uint8_t*)&app_regs.ttl_pulse_count, sizeof(app_regs.ttl_pulse_count), U8},
+    {(uint8_t*)&app_regs.ttl_bout_gap_ms, sizeof(app_regs.ttl_bout_gap_ms), U16},
+    {(uint8_t*)&app_regs.sample_rate_hz, sizeof(app_regs.sample_rate_hz), U32},
+    {(uint8_t*)&app_regs.samples_per_period, sizeof(app_regs.samples_per_period), U16},
+    {(uint8_t*)&app_regs.acquisition_recoveries, sizeof(app_regs.acquisition_recoveries), U32},
+    {(uint8_t*)&app_regs.settings_apply, sizeof(app_regs.settings_apply), U8},
+    {(uint8_t*)&app_regs.noise_snr_db_x10, sizeof(app_regs.noise_snr_db_x10), U16},
+    {(uint8_t*)&app_regs.noise_interference, sizeof(app_regs.noise_interference), U8},
+    {(uint8_t*)&app_regs.waveform_state, sizeof(app_regs.waveform_state), U8},
+    {(uint8_t*)&app_regs.waveform_pre_trigger, sizeof(app_regs.waveform_pre_trigger), U16},
+    {(uint8_t*)&app_regs.waveform_post_trigger, sizeof(app_regs.waveform_post_trigger), U16},
+    {(uint8_t*)&app_regs.waveform_info, sizeof(app_regs.waveform_info), U32},
+    {(uint8_t*)&app_regs.waveform_read_start, sizeof(app_regs.waveform_read_start), U32},
+    {(uint8_t*)&app_regs.waveform_samples, sizeof(app_regs.waveform_samples), U16},
+    {(uint8_t*)&app_regs.waveform_amplitude_read_start, sizeof(app_regs.waveform_amplitude_read_start), U32},
+    {(uint8_t*)&app_regs.waveform_amplitudes, sizeof(app_regs.waveform_amplitudes), U16},
+    {(uint8_t*)&app_regs.detection_mode, sizeof(app_regs.detection_mode), U8},
+    {(uint8_t*)&app_regs.cusum_threshold_q4, sizeof(app_regs.cusum_threshold_q4), U8},
+    {(uint8_t*)&app_regs.cusum_false_alarm_rate, sizeof(app_regs.cusum_false_alarm_rate), Float},
+    {(uint8_t*)&app_regs.decimation_factor, sizeof(app_regs.decimation_factor), U8},
+    {(uint8_t*)&app_regs.decimation_guard_q16, sizeof(app_regs.decimation_guard_q16), U16},
+    {(uint8_t*)&app_regs.processing_counts, sizeof(app_regs.processing_counts), U32},
+    {(uint8_t*)&app_regs.proximity_on_threshold_q16, sizeof(app_regs.proximity_on_threshold_q16), U16},
+    {(uint8_t*)&app_regs.proximity_off_threshold_q16, sizeof(app_regs.proximity_off_threshold_q16), U16},
+    {(uint8_t*)&app_regs.zscore_k_q4, sizeof(app_regs.zscore_k_q4), U8},
+    {(uint8_t*)&app_regs.zscore_statistics, sizeof(app_regs.zscore_statistics), Float},
+    {(uint8_t*)&app_regs.time_division_slots, sizeof(app_regs.time_division_slots), U8},
+    {(uint8_t*)&app_regs.time_division_index, sizeof(app_regs.time_division_index), U8},
+    {(uint8_t*)&app_regs.time_division_slot_us, sizeof(app_regs.time_division_slot_us), U16}
 };
 
 void update_on_threshold(msg_t& msg)
 {
     HarpCore::copy_msg_payload_to_register(msg);
+    // Mirror the setting in the high-resolution register.
+    uint32_t threshold_q16 = PERCENT_TO_Q16(app_regs.on_threshold);
+    app_regs.on_threshold_q16 = (threshold_q16 > 0xFFFF)? 0xFFFF: threshold_q16;
     // Push new value into the queue so that core1 can apply the change.
-    queue_try_add(&set_on_threshold_queue, &app_regs.on_threshold);
+    queue_try_add(&set_on_threshold_queue, &app_regs.on_threshold_q16);
+    core1_doorbell = true;
     if (!HarpCore::is_muted())
         HarpCore::send_harp_reply(WRITE, msg.header.address);
 }
@@ -86,33 +290,512 @@ void update_on_threshold(msg_t& msg)
 void update_off_threshold(msg_t& msg)
 {
     HarpCore::copy_msg_payload_to_register(msg);
+    // Mirror the setting in the high-resolution register.
+    uint32_t threshold_q16 = PERCENT_TO_Q16(app_regs.off_threshold);
+    app_regs.off_threshold_q16 = (threshold_q16 > 0xFFFF)? 0xFFFF: threshold_q16;
     // Push new value into the queue so that core1 can apply the change.
-    queue_try_add(&set_off_threshold_queue, &app_regs.off_threshold);
+    queue_try_add(&set_off_threshold_queue, &app_regs.off_threshold_q16);
+    core1_doorbell = true;
     if (!HarpCore::is_muted())
         HarpCore::send_harp_reply(WRITE, msg.header.address);
 }
 
-void update_app_state()
+void update_on_threshold_q16(msg_t& msg)
 {
-    // Update starting (or latest) values of the lick detector thresholds.
-    if (!queue_is_empty(&get_on_threshold_queue))
-        queue_remove_blocking(&get_on_threshold_queue, &app_regs.on_threshold);
-    if (!queue_is_empty(&get_off_threshold_queue))
-        queue_remove_blocking(&get_off_threshold_queue, &app_regs.off_threshold);
-    // Check multicore queue for new lick state and timestamp.
-    if (queue_is_empty(&lick_event_queue))
+    HarpCore::copy_msg_payload_to_register(msg);
+    // Mirror the setting (rounded) in the percent register.
+    app_regs.on_threshold = Q16_TO_PERCENT(app_regs.on_threshold_q16);
+    // Push new value into the queue so that core1 can apply the change.
+    queue_try_add(&set_on_threshold_queue, &app_regs.on_threshold_q16);
+    core1_doorbell = true;
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void update_off_threshold_q16(msg_t& msg)
+{
+    HarpCore::copy_msg_payload_to_register(msg);
+    // Mirror the setting (rounded) in the percent register.
+    app_regs.off_threshold = Q16_TO_PERCENT(app_regs.off_threshold_q16);
+    // Push new value into the queue so that core1 can apply the change.
+    queue_try_add(&set_off_threshold_queue, &app_regs.off_threshold_q16);
+    core1_doorbell = true;
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void configure_detection_mode()
+{
+    new_detection_mode.mode = app_regs.detection_mode;
+    new_detection_mode.cusum_threshold_q4 = app_regs.cusum_threshold_q4;
+    new_detection_mode.zscore_k_q4 = app_regs.zscore_k_q4;
+    queue_try_add(&detection_mode_queue, &new_detection_mode);
+    core1_doorbell = true;
+    app_regs.cusum_false_alarm_rate = 0; // Not measured yet.
+    app_regs.zscore_statistics[0] = 0;
+    app_regs.zscore_statistics[1] = 0;
+}
+
+void write_detection_mode(msg_t& msg)
+{
+    if (*((uint8_t*)msg.payload) > LickDetector::ZSCORE)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    configure_detection_mode();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_cusum_threshold(msg_t& msg)
+{
+    if (*((uint8_t*)msg.payload) == 0)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    configure_detection_mode();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_zscore_k(msg_t& msg)
+{
+    if (*((uint8_t*)msg.payload) == 0)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    configure_detection_mode();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void configure_decimation()
+{
+    new_decimation.factor = app_regs.decimation_factor;
+    new_decimation.guard_q16 = app_regs.decimation_guard_q16;
+    queue_try_add(&decimation_queue, &new_decimation);
+    core1_doorbell = true;
+}
+
+void write_decimation_factor(msg_t& msg)
+{
+    uint8_t factor = *((uint8_t*)msg.payload);
+    if (factor < 1 || factor > MAX_DECIMATION_FACTOR)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    configure_decimation();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_decimation_guard(msg_t& msg)
+{
+    HarpCore::copy_msg_payload_to_register(msg);
+    configure_decimation();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void configure_proximity_thresholds()
+{
+    new_proximity_thresholds.on_threshold_q16 =
+        app_regs.proximity_on_threshold_q16;
+    new_proximity_thresholds.off_threshold_q16 =
+        app_regs.proximity_off_threshold_q16;
+    queue_try_add(&proximity_thresholds_queue, &new_proximity_thresholds);
+    core1_doorbell = true;
+}
+
+void write_proximity_threshold(msg_t& msg)
+{
+    HarpCore::copy_msg_payload_to_register(msg);
+    configure_proximity_thresholds();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+/**
+ * \brief Harp time minus system time. Changes when the Harp clock is
+ *  synchronized.
+ */
+int64_t get_harp_offset_us()
+{
+    uint64_t system_time_us = time_us_64();
+    return int64_t(HarpCore::system_to_harp_us_64(system_time_us)
+                   - system_time_us);
+}
+
+void configure_time_division()
+{
+    new_time_division.slot_count = app_regs.time_division_slots;
+    new_time_division.board_index = app_regs.time_division_index;
+    new_time_division.slot_us = app_regs.time_division_slot_us;
+    new_time_division.harp_offset_us = get_harp_offset_us();
+    queue_try_add(&time_division_queue, &new_time_division);
+    core1_doorbell = true;
+}
+
+void write_time_division_slots(msg_t& msg)
+{
+    uint8_t slot_count = *((uint8_t*)msg.payload);
+    if (slot_count > TIME_DIVISION_MAX_SLOTS
+        || (slot_count > 1 && app_regs.time_division_index >= slot_count))
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    configure_time_division();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_time_division_index(msg_t& msg)
+{
+    uint8_t board_index = *((uint8_t*)msg.payload);
+    uint8_t slot_count = app_regs.time_division_slots;
+    if (board_index >= TIME_DIVISION_MAX_SLOTS
+        || (slot_count > 1 && board_index >= slot_count))
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
-    queue_remove_blocking(&lick_event_queue, &new_lick_state);
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    configure_time_division();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_time_division_slot_us(msg_t& msg)
+{
+    if (*((uint16_t*)msg.payload) < TIME_DIVISION_MIN_SLOT_US)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    configure_time_division();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_sweep_state(msg_t& msg)
+{
+#if defined(AD9833_EXCITATION)
+    uint8_t requested_state = *((uint8_t*)msg.payload);
+    uint32_t start_hz = app_regs.sweep_start_hz;
+    uint32_t stop_hz = app_regs.sweep_stop_hz;
+    bool valid_range = (start_hz >= SWEEP_MIN_FREQ_HZ)
+                       && (start_hz <= SWEEP_MAX_FREQ_HZ)
+                       && (stop_hz >= SWEEP_MIN_FREQ_HZ)
+                       && (stop_hz <= SWEEP_MAX_FREQ_HZ);
+    if (requested_state > SWEEP_RUNNING
+        || (requested_state == SWEEP_RUNNING && !valid_range))
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    new_sweep_request.start = (requested_state == SWEEP_RUNNING);
+    new_sweep_request.start_hz = start_hz;
+    new_sweep_request.stop_hz = stop_hz;
+    queue_try_add(&sweep_request_queue, &new_sweep_request);
+    core1_doorbell = true;
+    app_regs.sweep_state = requested_state;
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+#else
+    // Sweeps require the AD9833 function generator.
+    HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+#endif
+}
+
+void write_lick_history_read_start(msg_t& msg)
+{
+    HarpCore::copy_msg_payload_to_register(msg);
+    // Load the requested window so it can be read back in bulk.
+    lick_history.copy_window(app_regs.lick_history_read_start,
+                             app_regs.lick_history_timestamps,
+                             app_regs.lick_history_states,
+                             LICK_HISTORY_WINDOW_SIZE);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_waveform_state(msg_t& msg)
+{
+    uint8_t requested_state = *((uint8_t*)msg.payload);
+    // Pre/post-trigger periods and the trigger period must fit in the ring
+    // at the samples per period core1 is running, not a staged value.
+    size_t capacity_periods = WAVEFORM_RING_SAMPLES
+                              / new_detector_settings.samples_per_period;
+    bool valid_window = (size_t(app_regs.waveform_pre_trigger)
+                         + app_regs.waveform_post_trigger) < capacity_periods;
+    if (requested_state > WaveformCapture::TRIGGERED
+        || (requested_state == WaveformCapture::ARMED && !valid_window)
+        || (requested_state == WaveformCapture::TRIGGERED
+            && app_regs.waveform_state != WaveformCapture::ARMED))
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    new_waveform_request.state = requested_state;
+    new_waveform_request.pre_trigger_periods = app_regs.waveform_pre_trigger;
+    new_waveform_request.post_trigger_periods = app_regs.waveform_post_trigger;
+    queue_try_add(&waveform_request_queue, &new_waveform_request);
+    core1_doorbell = true;
+    // Reads back ARMED until core1 reports a finished snapshot.
+    if (requested_state != WaveformCapture::TRIGGERED)
+        app_regs.waveform_state = requested_state;
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_waveform_read_start(msg_t& msg)
+{
+    HarpCore::copy_msg_payload_to_register(msg);
+    // Snapshot is only stable (and readable) while READY.
+    waveform_capture.copy_samples(app_regs.waveform_read_start,
+                                  app_regs.waveform_samples,
+                                  WAVEFORM_WINDOW_SIZE);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_waveform_amplitude_read_start(msg_t& msg)
+{
+    HarpCore::copy_msg_payload_to_register(msg);
+    waveform_capture.copy_amplitudes(app_regs.waveform_amplitude_read_start,
+                                     app_regs.waveform_amplitudes,
+                                     WAVEFORM_WINDOW_SIZE);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void configure_ttl_output()
+{
+    new_ttl_config.mode = app_regs.ttl_mode;
+    new_ttl_config.pulse_width_us = app_regs.ttl_pulse_width_us;
+    new_ttl_config.pulse_period_us = app_regs.ttl_pulse_period_us;
+    new_ttl_config.pulse_count = app_regs.ttl_pulse_count;
+    new_ttl_config.bout_gap_ms = app_regs.ttl_bout_gap_ms;
+    queue_try_add(&ttl_config_queue, &new_ttl_config);
+    core1_doorbell = true;
+}
+
+/**
+ * \brief mark settings as changed. They are applied together once writes
+ *  stop for SETTINGS_COMMIT_WINDOW_US or upon a write to settings_apply.
+ */
+void stage_settings(bool detector_settings, bool ttl_config)
+{
+    detector_settings_pending |= detector_settings;
+    ttl_config_pending |= ttl_config;
+    settings_commit_time_us = time_us_64() + SETTINGS_COMMIT_WINDOW_US;
+    app_regs.settings_apply = 1;
+}
+
+/**
+ * \brief apply all staged settings.
+ */
+void commit_settings();
+
+void write_ttl_mode(msg_t& msg)
+{
+    if (*((uint8_t*)msg.payload) > TtlOutput::BOUT_ONE_SHOT)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    stage_settings(false, true);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_ttl_setting(msg_t& msg)
+{
+    HarpCore::copy_msg_payload_to_register(msg);
+    stage_settings(false, true);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+/**
+ * \brief convert sample clock periods to microseconds (rounded down).
+ *  Works from the samples and sample rate, since a period is not always a
+ *  whole number of nanoseconds and a rounded one drifts over a long stream.
+ */
+uint64_t periods_to_us(uint64_t periods, uint16_t samples_per_period,
+                       uint32_t sample_rate_hz)
+{
+    uint64_t samples = periods * samples_per_period;
+    // Split into whole seconds and the rest so the product cannot overflow.
+    return (samples / sample_rate_hz) * 1000000ull
+           + ((samples % sample_rate_hz) * 1000000ull) / sample_rate_hz;
+}
+
+void dispatch_lick_event(lick_event_t& lick_event)
+{
     // Update register with new lick state.
-    app_regs.lick_state = new_lick_state.state;
+    app_regs.lick_state = lick_event.state;
     // Issue harp EVENT reply.
 #ifdef DEBUG
-    printf("lick state: %02b\r\n", new_lick_state.state);
+    printf("lick state: %02b\r\n", lick_event.state);
 #endif
-    const RegSpecs& reg_specs = app_reg_specs[0];
     // Package data with timestamp taken with the detected lick state.
-    uint64_t lick_harp_time_us = HarpCore::system_to_harp_us_64(new_lick_state.pico_time_us);
+    // Convert from the sample clock to system time, then to harp time.
+    uint64_t lick_pico_time_us = lick_event.stream_start_us
+        + periods_to_us(lick_event.period, lick_event.samples_per_period,
+                        lick_event.sample_rate_hz);
+    uint64_t lick_harp_time_us = HarpCore::system_to_harp_us_64(lick_pico_time_us);
+    // Keep a record in case the host misses the event.
+    lick_history.push(lick_event.state, lick_harp_time_us);
+    app_regs.lick_history_count = lick_history.count();
     HarpCApp::send_harp_reply(EVENT, APP_REG_START_ADDRESS, lick_harp_time_us);
+    // Follow up with the full sequence number so the host can spot gaps.
+    HarpCApp::send_harp_reply(EVENT, APP_REG_START_ADDRESS + 8,
+                              lick_harp_time_us);
+}
+
+void dispatch_lick_features(lick_features_event_t& event)
+{
+    const contact_features_t& features = event.features;
+    uint64_t duration_us = periods_to_us(features.duration_periods,
+                                         event.samples_per_period,
+                                         event.sample_rate_hz);
+    uint64_t depth_q16 = 0;
+    if (features.upscaled_baseline > features.upscaled_min_amplitude)
+        depth_q16 = (uint64_t(features.upscaled_baseline
+                              - features.upscaled_min_amplitude) << 16)
+                    / features.upscaled_baseline;
+    uint64_t deficit_counts_us = periods_to_us(
+        features.upscaled_deficit / UPSCALE_FACTOR, event.samples_per_period,
+        event.sample_rate_hz);
+    app_regs.lick_features[0] = event.channel;
+    app_regs.lick_features[1] = (duration_us > 0xFFFFFFFF)?
+                                0xFFFFFFFF: duration_us;
+    app_regs.lick_features[2] = (depth_q16 > 0xFFFF)? 0xFFFF: depth_q16;
+    app_regs.lick_features[3] = (deficit_counts_us > 0xFFFFFFFF)?
+                                0xFFFFFFFF: deficit_counts_us;
+    // Same timestamp as the LickState event that ended the contact.
+    uint64_t pico_time_us = event.stream_start_us
+        + periods_to_us(event.period, event.samples_per_period,
+                        event.sample_rate_hz);
+    uint64_t harp_time_us = HarpCore::system_to_harp_us_64(pico_time_us);
+    HarpCApp::send_harp_reply(EVENT, APP_REG_START_ADDRESS + 14, harp_time_us);
+}
+
+void dispatch_acquisition_fault(acquisition_fault_t& fault)
+{
+    app_regs.acquisition_recoveries = fault.recovery_count;
+#if defined(DEBUG)
+    printf("ADC stream stalled. Recoveries: %u\r\n", fault.recovery_count);
+#endif
+    uint64_t harp_time_us = HarpCore::system_to_harp_us_64(fault.time_us);
+    HarpCApp::send_harp_reply(EVENT, APP_REG_START_ADDRESS + 22, harp_time_us);
+}
+
+void dispatch_waveform_event(waveform_event_t& event)
+{
+    app_regs.waveform_info[0] = waveform_capture.samples_per_period();
+    app_regs.waveform_info[1] = waveform_capture.period_count();
+    app_regs.waveform_info[2] = waveform_capture.trigger_index();
+    app_regs.waveform_info[3] = (uint64_t(event.samples_per_period)
+                                 * 1000000000ull) / event.sample_rate_hz;
+    app_regs.waveform_state = WaveformCapture::READY;
+    // Stamp with the trigger period, like the lick event it captured.
+    uint64_t pico_time_us = event.stream_start_us
+        + periods_to_us(event.period, event.samples_per_period,
+                        event.sample_rate_hz);
+    uint64_t harp_time_us = HarpCore::system_to_harp_us_64(pico_time_us);
+    HarpCApp::send_harp_reply(EVENT, APP_REG_START_ADDRESS + 26, harp_time_us);
+}
+
+void update_detector_stats(detector_stats_t& stats)
+{
+    app_regs.processing_counts[0] = stats.processed_periods;
+    app_regs.processing_counts[1] = stats.skipped_periods;
+    // Statistics are only tracked in ZSCORE mode.
+    app_regs.zscore_statistics[0] = float(stats.zscore_mean) / UPSCALE_FACTOR;
+    app_regs.zscore_statistics[1] = float(stats.zscore_sigma) / UPSCALE_FACTOR;
+    // Noise is only measured in CUSUM mode.
+    float run_length_periods = LickDetector::cusum_average_run_length(
+        stats.cusum_drift, stats.cusum_limit, stats.noise_mad);
+    if (run_length_periods == 0) // Noise not measured yet.
+    {
+        app_regs.cusum_false_alarm_rate = 0;
+        return;
+    }
+    float periods_per_hour = 3.6e12f / stats.period_ns;
+    app_regs.cusum_false_alarm_rate = periods_per_hour / run_length_periods;
+}
+
+void dispatch_noise_capture(noise_capture_t& capture)
+{
+    bool changed = noise_monitor.analyze(capture.samples, capture.sample_count,
+                                         capture.periods);
+    app_regs.noise_snr_db_x10 = noise_monitor.snr_db_x10();
+    app_regs.noise_interference = noise_monitor.interference_detected();
+    if (changed && !HarpCore::is_muted())
+        HarpCApp::send_harp_reply(EVENT, APP_REG_START_ADDRESS + 25);
+}
+
+void update_app_state()
+{
+    // Apply staged settings once writes stop arriving.
+    if ((detector_settings_pending || ttl_config_pending)
+        && time_us_64() >= settings_commit_time_us)
+        commit_settings();
+    // Follow the Harp clock's synchronization with the time division
+    // schedule.
+    if (app_regs.time_division_slots > 1
+        && get_harp_offset_us() != new_time_division.harp_offset_us)
+        configure_time_division();
+    // Only touch the queues (and their spin locks, which core1 also needs)
+    // when core1 has published something.
+    if (!core0_doorbell)
+        return;
+    core0_doorbell = false; // Clear first so no push from core1 is missed.
+    // Publish the frequency sweep table once core1 finishes a sweep.
+    if (queue_try_remove(&sweep_result_queue, &new_sweep_result))
+    {
+        for (uint8_t i = 0; i < SWEEP_STEP_COUNT; ++i)
+            app_regs.sweep_amplitudes[i] = new_sweep_result.amplitudes[i];
+        app_regs.sweep_state = SWEEP_DONE;
+        if (!HarpCore::is_muted())
+            HarpCApp::send_harp_reply(EVENT, APP_REG_START_ADDRESS + 6);
+    }
+    // Update starting (or latest) values of the lick detector thresholds.
+    while (queue_try_remove(&get_on_threshold_queue,
+                            &app_regs.on_threshold_q16))
+        app_regs.on_threshold = Q16_TO_PERCENT(app_regs.on_threshold_q16);
+    while (queue_try_remove(&get_off_threshold_queue,
+                            &app_regs.off_threshold_q16))
+        app_regs.off_threshold = Q16_TO_PERCENT(app_regs.off_threshold_q16);
+    // Report acquisition stalls before the lick events they released.
+    while (queue_try_remove(&acquisition_fault_queue, &new_acquisition_fault))
+        dispatch_acquisition_fault(new_acquisition_fault);
+    // Dispatch all new lick states and timestamps in one batch.
+    while (queue_try_remove(&lick_event_queue, &new_lick_state))
+        dispatch_lick_event(new_lick_state);
+    while (queue_try_remove(&lick_features_queue, &new_lick_features))
+        dispatch_lick_features(new_lick_features);
+    while (queue_try_remove(&detector_stats_queue, &new_detector_stats))
+        update_detector_stats(new_detector_stats);
+    while (queue_try_remove(&waveform_event_queue, &new_waveform_event))
+        dispatch_waveform_event(new_waveform_event);
+    // Noise floor analysis is the lowest priority.
+    if (queue_try_remove(&noise_capture_queue, &new_noise_capture))
+        dispatch_noise_capture(new_noise_capture);
 }
 
 /**
@@ -125,6 +808,7 @@ void configure_signal_chain(bool freq_setting, bool amplitude_setting)
 {
     // Setup 20mVpp or 2Vpp excitation signal.
     // Setup 100-or-125KHz square wave output. (New way on v0.6.0+)
+#if !defined(AD9833_EXCITATION) // AD9833 frequency is set by core1.
     uint pwm_pin = freq_setting? SQUARE_WAVE_PIN_100KHZ: SQUARE_WAVE_PIN_125KHZ;
     uint idle_pin = freq_setting? SQUARE_WAVE_PIN_125KHZ: SQUARE_WAVE_PIN_100KHZ;
 #if defined(DEBUG)
@@ -148,6 +832,7 @@ void configure_signal_chain(bool freq_setting, bool amplitude_setting)
     pwm_set_wrap(pwm_slice_num, pwm_wrap);
     pwm_set_chan_level(pwm_slice_num, gpio_channel, pwm_chan_level);
     pwm_set_enabled(pwm_slice_num, true);
+#endif
     // Init GPIO output pins for configuring analog front-end.
     gpio_init(FILTER_SEL_PIN);
     gpio_init(GAIN_SEL_PIN);
@@ -161,16 +846,120 @@ void configure_signal_chain(bool freq_setting, bool amplitude_setting)
 
 void configure_lick_detector()
 {
-    queue_try_add(&detector_settings_queue, &app_regs.settings);
+    new_detector_settings.settings = app_regs.settings;
+    new_detector_settings.sample_rate_hz = app_regs.sample_rate_hz;
+    new_detector_settings.samples_per_period = app_regs.samples_per_period;
+    queue_try_add(&detector_settings_queue, &new_detector_settings);
+    core1_doorbell = true;
+}
+
+/**
+ * \brief samples in one period of the excitation frequency in the settings
+ *  register at the sample rate register's rate. Core1 cannot keep up with
+ *  shorter periods.
+ */
+uint32_t excitation_samples_per_period()
+{
+    uint32_t excitation_freq_hz = bool(app_regs.settings & 0x01)?
+                                  100000: 125000;
+    uint32_t samples_per_period = app_regs.sample_rate_hz / excitation_freq_hz;
+    if (samples_per_period < ADS7049_MIN_SAMPLES_PER_PERIOD)
+        samples_per_period = ADS7049_MIN_SAMPLES_PER_PERIOD;
+    return samples_per_period;
 }
 
 void write_settings(msg_t& msg)
 {
     HarpCore::copy_msg_payload_to_register(msg);
-    bool apply_100khz = bool(app_regs.settings & 0x01);
-    bool apply_millivolts = bool((app_regs.settings >> 1u) & 0x01);
-    configure_signal_chain(apply_100khz, apply_millivolts);
-    configure_lick_detector(); // apply settings app register.
+    sample_rate_or_settings_staged = true;
+    stage_settings(true, false);
+    if (!HarpCore::is_muted())
+        HarpCApp::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_sample_rate(msg_t& msg)
+{
+    uint32_t sample_rate_hz = *((uint32_t*)msg.payload);
+    if (sample_rate_hz < ADS7049_MIN_SAMPLE_RATE_HZ
+        || sample_rate_hz > ADS7049_MAX_SAMPLE_RATE_HZ)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    sample_rate_or_settings_staged = true;
+    stage_settings(true, false);
+    if (!HarpCore::is_muted())
+        HarpCApp::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_samples_per_period(msg_t& msg)
+{
+    uint16_t samples_per_period = *((uint16_t*)msg.payload);
+    // Checked against the settings and sample rate written so far.
+    if (samples_per_period < excitation_samples_per_period()
+        || samples_per_period > ADS7049_MAX_SAMPLES_PER_PERIOD)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    samples_per_period_staged = true;
+    stage_settings(true, false);
+    if (!HarpCore::is_muted())
+        HarpCApp::send_harp_reply(WRITE, msg.header.address);
+}
+
+void commit_settings()
+{
+    if (detector_settings_pending)
+    {
+        // Settings and sample rate writes reset samples per period to one
+        // excitation period, unless it was written in the same burst. A
+        // value written before a later rate or frequency change in the same
+        // burst may have become too short for it.
+        uint32_t min_samples_per_period = excitation_samples_per_period();
+        if ((sample_rate_or_settings_staged && !samples_per_period_staged)
+            || app_regs.samples_per_period < min_samples_per_period)
+            app_regs.samples_per_period = min_samples_per_period;
+        // Only reconfigure the analog front-end (and PWM) if it changed.
+        uint8_t signal_chain = app_regs.settings & 0x03;
+        if (first_reset || signal_chain != applied_signal_chain)
+        {
+            configure_signal_chain(bool(signal_chain & 0x01),
+                                   bool((signal_chain >> 1u) & 0x01));
+            applied_signal_chain = signal_chain;
+        }
+        configure_lick_detector(); // One reset for all staged writes.
+#if defined(AD9833_EXCITATION)
+        // Core1 aborts any sweep in progress to apply the new excitation.
+        if (app_regs.sweep_state == SWEEP_RUNNING)
+        {
+            app_regs.sweep_state = SWEEP_IDLE;
+            if (!HarpCore::is_muted())
+                HarpCApp::send_harp_reply(EVENT, APP_REG_START_ADDRESS + 6);
+        }
+#endif
+        // Measure the floor again for the new settings.
+        noise_monitor.reset();
+        // Core1 discards the waveform snapshot when samples per period change.
+        app_regs.waveform_state = WaveformCapture::IDLE;
+        app_regs.noise_snr_db_x10 = noise_monitor.snr_db_x10();
+        app_regs.noise_interference = noise_monitor.interference_detected();
+    }
+    if (ttl_config_pending)
+        configure_ttl_output();
+    detector_settings_pending = false;
+    ttl_config_pending = false;
+    sample_rate_or_settings_staged = false;
+    samples_per_period_staged = false;
+    app_regs.settings_apply = 0;
+}
+
+void write_settings_apply(msg_t& msg)
+{
+    if (*((uint8_t*)msg.payload))
+        commit_settings();
     if (!HarpCore::is_muted())
         HarpCApp::send_harp_reply(WRITE, msg.header.address);
 }
@@ -183,10 +972,33 @@ void reset_app()
 #if defined(DEBUG)
     printf("Starting DIP switch settings: %d\r\n", app_regs.settings);
 #endif
-    bool apply_100khz = bool(app_regs.settings & 0x01);
-    bool apply_millivolts = bool((app_regs.settings >> 1u) & 0x01);
-    configure_signal_chain(apply_100khz, apply_millivolts);
-    configure_lick_detector(); // apply settings app register.
+    app_regs.sample_rate_hz = ADC_SAMPLE_RATE_HZ;
+    sample_rate_or_settings_staged = true; // Derive samples per period.
+    samples_per_period_staged = false;
+    app_regs.ttl_mode = TtlOutput::LEVEL;
+    app_regs.ttl_pulse_width_us = DEFAULT_TTL_PULSE_WIDTH_US;
+    app_regs.ttl_pulse_period_us = DEFAULT_TTL_PULSE_PERIOD_US;
+    app_regs.ttl_pulse_count = DEFAULT_TTL_PULSE_COUNT;
+    app_regs.ttl_bout_gap_ms = DEFAULT_TTL_BOUT_GAP_MS;
+    app_regs.waveform_pre_trigger = DEFAULT_WAVEFORM_PRE_TRIGGER_PERIODS;
+    app_regs.detection_mode = LickDetector::CONSENSUS;
+    app_regs.cusum_threshold_q4 = DEFAULT_CUSUM_THRESHOLD_Q4;
+    app_regs.zscore_k_q4 = DEFAULT_ZSCORE_K_Q4;
+    configure_detection_mode();
+    app_regs.decimation_factor = 1;
+    app_regs.decimation_guard_q16 = DEFAULT_GUARD_Q16;
+    configure_decimation();
+    app_regs.proximity_on_threshold_q16 = DEFAULT_PROXIMITY_ON_THRESHOLD_Q16;
+    app_regs.proximity_off_threshold_q16 = DEFAULT_PROXIMITY_OFF_THRESHOLD_Q16;
+    configure_proximity_thresholds();
+    app_regs.time_division_slots = 0;
+    app_regs.time_division_index = 0;
+    app_regs.time_division_slot_us = TIME_DIVISION_DEFAULT_SLOT_US;
+    configure_time_division();
+    app_regs.waveform_post_trigger = DEFAULT_WAVEFORM_POST_TRIGGER_PERIODS;
+    // Apply everything now. Don't wait for the commit window.
+    stage_settings(true, true);
+    commit_settings();
     first_reset = false;
     // TODO: clear all queues?
 }
@@ -197,7 +1009,50 @@ RegFnPair reg_handler_fns[reg_count]
     {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
     {&HarpCore::read_reg_generic, &update_on_threshold},
     {&HarpCore::read_reg_generic, &update_off_threshold},
-    {&HarpCore::read_reg_generic, &write_settings}
+    {&HarpCore::read_reg_generic, &write_settings},
+    {&HarpCore::read_reg_generic, &HarpCore::write_reg_generic},
+    {&HarpCore::read_reg_generic, &HarpCore::write_reg_generic},
+    {&HarpCore::read_reg_generic, &write_sweep_state},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_lick_history_read_start},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &update_on_threshold_q16},
+    {&HarpCore::read_reg_generic, &update_off_threshold_q16},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_ttl_mode},
+    {&HarpCore::read_reg_generic, &write_ttl_setting},
+    {&HarpCore::read_reg_generic, &write_ttl_setting},
+    {&HarpCore::read_reg_generic, &write_ttl_setting},
+    {&HarpCore::read_reg_generic, &write_ttl_setting},
+    {&HarpCore::read_reg_generic, &write_sample_rate},
+    {&HarpCore::read_reg_generic, &write_samples_per_period},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_settings_apply},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_waveform_state},
+    {&HarpCore::read_reg_generic, &HarpCore::write_reg_generic},
+    {&HarpCore::read_reg_generic, &HarpCore::write_reg_generic},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_waveform_read_start},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_waveform_amplitude_read_start},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_detection_mode},
+    {&HarpCore::read_reg_generic, &write_cusum_threshold},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_decimation_factor},
+    {&HarpCore::read_reg_generic, &write_decimation_guard},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_proximity_threshold},
+    {&HarpCore::read_reg_generic, &write_proximity_threshold},
+    {&HarpCore::read_reg_generic, &write_zscore_k},
+    {&HarpCore::read_reg_generic, &HarpCore::write_to_read_only_reg_error},
+    {&HarpCore::read_reg_generic, &write_time_division_slots},
+    {&HarpCore::read_reg_generic, &write_time_division_index},
+    {&HarpCore::read_reg_generic, &write_time_division_slot_us}
 };
 
 // Create Harp "App."
@@ -214,15 +1069,12 @@ HarpCApp& app = HarpCApp::init(HARP_DEVICE_ID,
 
 // General strategy:
 // Configure SPI ADC to write to memory continuously.
-// Every waveform period (20 or 16 samples @ 2MHz), compute sampled amplitude.
+// Every waveform period (SampleRate and SamplesPerPeriod registers; 20 or 16
+// samples @ 2MHz by default), compute sampled amplitude.
 // If lower than nominal amplitude, lick detected.
 
-// Deprecated: init Function Generator Chip and set 100KHz.
-// Create AS9833 instance and init underlying SPI hardware (default behavior).
-// Note: device is set to SPI mode 2, 32[MHz]
-// TODO: remove need for RX pin input as parameter.
-//AD9833 ad9833(12e6L, spi0, AD9833_SPI_TX_PIN, AD9833_SPI_RX_PIN,
-//              AD9833_SPI_SCK_PIN, AD9833_SPI_CS_PIN);
+// Function Generator Chip (hardware v0.5) is owned by core1 when the
+// AD9833_EXCITATION flag is defined. See core1_lick_detection.cpp.
 
 int main()
 {
@@ -237,16 +1089,6 @@ int main()
     app.set_visual_indicators_fn(set_led_state);
     app.set_synchronizer(&sync);
 
-    // Setup Sine wave generator. Old way on v0.5.0.
-    //ad9833.disable_output(); // aka: reset.
-    //sleep_ms(50);
-    //ad9833.set_frequency_hz(100e3);
-    //sleep_us(10);
-    //ad9833.set_phase_raw(0);
-    //sleep_us(10);
-    //ad9833.enable_with_waveform(AD9833::waveform_t::SINE);
-    //sleep_ms(100);
-
     // Give core1 bus priority since it is running a timely control loop.
     // This will drop cycle count by about 100 cycles.
     bus_ctrl_hw->priority = 0x00000010; // PROC1 = priority[4]. Set to 1.
@@ -255,11 +1097,24 @@ int main()
     // Queue needs to be much larger than expected such that device enumerates
     // over USB.
     queue_init(&lick_event_queue, sizeof(lick_event_t), 32);
-    queue_init(&set_on_threshold_queue, sizeof(uint8_t), 32);
-    queue_init(&set_off_threshold_queue, sizeof(uint8_t), 32);
-    queue_init(&get_on_threshold_queue, sizeof(uint8_t), 32);
-    queue_init(&get_off_threshold_queue, sizeof(uint8_t), 32);
-    queue_init(&detector_settings_queue, sizeof(app_regs.settings), 32);
+    queue_init(&lick_features_queue, sizeof(lick_features_event_t), 32);
+    queue_init(&set_on_threshold_queue, sizeof(uint16_t), 32);
+    queue_init(&set_off_threshold_queue, sizeof(uint16_t), 32);
+    queue_init(&get_on_threshold_queue, sizeof(uint16_t), 32);
+    queue_init(&get_off_threshold_queue, sizeof(uint16_t), 32);
+    queue_init(&detector_settings_queue, sizeof(detector_settings_t), 32);
+    queue_init(&detection_mode_queue, sizeof(detection_mode_t), 4);
+    queue_init(&decimation_queue, sizeof(decimation_t), 4);
+    queue_init(&proximity_thresholds_queue, sizeof(proximity_thresholds_t), 4);
+    queue_init(&time_division_queue, sizeof(time_division_t), 4);
+    queue_init(&detector_stats_queue, sizeof(detector_stats_t), 2);
+    queue_init(&sweep_request_queue, sizeof(sweep_request_t), 4);
+    queue_init(&sweep_result_queue, sizeof(sweep_result_t), 1);
+    queue_init(&ttl_config_queue, sizeof(ttl_config_t), 4);
+    queue_init(&acquisition_fault_queue, sizeof(acquisition_fault_t), 4);
+    queue_init(&noise_capture_queue, sizeof(noise_capture_t), 1);
+    queue_init(&waveform_request_queue, sizeof(waveform_request_t), 4);
+    queue_init(&waveform_event_queue, sizeof(waveform_event_t), 2);
 
     // Init GPIO pins to evaluate device state.
     gpio_init(FREQ_SEL_DIP_PIN); // DIP switch input pin.
@@ -268,6 +1123,8 @@ int main()
     // based on hardware switch settings.
     reset_app();
 
+    core0_doorbell = false; // core1 has not published anything yet.
+
     // Launch Core1, which will process incoming adc samples and detect licks.
     // Core1 will also setup periodic ADC sampling, writing to memory, and
     // handle DMA-triggered interrupts.
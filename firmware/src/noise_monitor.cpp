@@ -0,0 +1,82 @@
+#include <noise_monitor.h>
+#include <math.h>
+
+NoiseMonitor::NoiseMonitor()
+{
+    reset();
+}
+
+NoiseMonitor::~NoiseMonitor(){}
+
+void NoiseMonitor::reset()
+{
+    snr_db_x10_ = NOISE_MAX_SNR_DB_X10;
+    interference_ = false;
+}
+
+uint64_t NoiseMonitor::goertzel_power(const uint16_t* samples, size_t n,
+                                      size_t k, int32_t mean)
+{
+    // coef = 2cos(2*pi*k/n). Only computed once per bin per capture.
+    int32_t coef_q14 = lroundf(2.f * cosf((2.f * float(M_PI) * k) / n)
+                               * (1u << NOISE_COEF_FRAC_BITS));
+    // Samples are 12-bit, so the state stays well within 32 bits for
+    // NOISE_MAX_WINDOW_SAMPLES. Only the coefficient product needs 64.
+    int32_t s1 = 0;
+    int32_t s2 = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        int32_t s0 = (int32_t(samples[i]) - mean)
+                     + int32_t((int64_t(coef_q14) * s1)
+                               >> NOISE_COEF_FRAC_BITS)
+                     - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    int64_t power = int64_t(s1) * s1 + int64_t(s2) * s2
+                    - ((int64_t(coef_q14) * s1) >> NOISE_COEF_FRAC_BITS) * s2;
+    return (power < 0)? 0: uint64_t(power); // Rounding can dip below 0.
+}
+
+bool NoiseMonitor::analyze(const uint16_t* samples, size_t sample_count,
+                           size_t periods)
+{
+    if (periods < NOISE_MIN_WINDOW_PERIODS
+        || sample_count > NOISE_MAX_WINDOW_SAMPLES)
+        return false;
+    // Remove DC so it can't leak into the low bins through rounding.
+    uint32_t sum = 0;
+    for (size_t i = 0; i < sample_count; ++i)
+        sum += samples[i];
+    int32_t mean = sum / sample_count;
+    // Excitation lands on bin k == periods.
+    uint64_t signal_power = goertzel_power(samples, sample_count, periods,
+                                           mean);
+    const int8_t bin_offsets[NOISE_BIN_COUNT] {-2, -1, 1, 2};
+    uint64_t noise_power = 0;
+    for (size_t i = 0; i < NOISE_BIN_COUNT; ++i)
+        noise_power += goertzel_power(samples, sample_count,
+                                      periods + bin_offsets[i], mean);
+    noise_power /= NOISE_BIN_COUNT;
+    // Power ratio to tenths of a dB.
+    if (noise_power == 0)
+        snr_db_x10_ = NOISE_MAX_SNR_DB_X10;
+    else if (signal_power <= noise_power)
+        snr_db_x10_ = 0;
+    else
+    {
+        float snr_db_x10 = 100.f * log10f(float(signal_power)
+                                          / float(noise_power));
+        snr_db_x10_ = (snr_db_x10 > NOISE_MAX_SNR_DB_X10)?
+                      NOISE_MAX_SNR_DB_X10: uint16_t(snr_db_x10);
+    }
+    // Hysteresis keeps the flag from chattering near the threshold.
+    bool interference = interference_;
+    if (snr_db_x10_ < NOISE_INTERFERENCE_SNR_DB_X10)
+        interference = true;
+    else if (snr_db_x10_ > NOISE_CLEAR_SNR_DB_X10)
+        interference = false;
+    bool changed = (interference != interference_);
+    interference_ = interference;
+    return changed;
+}
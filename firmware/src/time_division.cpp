@@ -0,0 +1,48 @@
+#include <time_division.h>
+
+TimeDivision::TimeDivision()
+:slot_count_{0}, board_index_{0}, slot_us_{TIME_DIVISION_DEFAULT_SLOT_US},
+ cycle_us_{0}, synced_{false}, slot_{0}, slot_start_us_{0},
+ slot_offset_us_{0}
+{}
+
+TimeDivision::~TimeDivision(){}
+
+void TimeDivision::configure(uint8_t slot_count, uint8_t board_index,
+                             uint32_t slot_us)
+{
+    slot_count_ = slot_count;
+    board_index_ = board_index;
+    slot_us_ = (slot_us < TIME_DIVISION_MIN_SLOT_US)?
+               TIME_DIVISION_MIN_SLOT_US:
+               slot_us;
+    cycle_us_ = uint64_t(slot_count_) * slot_us_;
+    synced_ = false; // Locate the slot on the next update().
+    slot_ = 0;
+    slot_offset_us_ = 0;
+}
+
+void TimeDivision::resync(uint64_t harp_time_us)
+{
+    uint64_t slot_number = harp_time_us / slot_us_;
+    slot_start_us_ = slot_number * slot_us_;
+    slot_ = slot_number % slot_count_;
+    synced_ = true;
+}
+
+void __core1_func(TimeDivision::update)(uint64_t harp_time_us)
+{
+    if (!enabled())
+        return;
+    // Resync if time went backwards or skipped more than a whole schedule.
+    if (!synced_ || harp_time_us < slot_start_us_
+        || (harp_time_us - slot_start_us_) >= cycle_us_)
+        resync(harp_time_us);
+    while ((harp_time_us - slot_start_us_) >= slot_us_)
+    {
+        slot_start_us_ += slot_us_;
+        if (++slot_ == slot_count_)
+            slot_ = 0;
+    }
+    slot_offset_us_ = harp_time_us - slot_start_us_;
+}
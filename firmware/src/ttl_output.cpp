@@ -0,0 +1,110 @@
+#include <ttl_output.h>
+
+TtlOutput::TtlOutput(PIO pio, uint pin)
+:pio_{pio}, pin_{pin}, program_{nullptr}, program_offset_{0},
+ high_cycles_{0}, low_cycles_{0}, last_lick_stop_us_{0}
+{
+    sm_ = pio_claim_unused_sm(pio_, true);
+    ttl_config_t config{LEVEL, DEFAULT_TTL_PULSE_WIDTH_US,
+                        DEFAULT_TTL_PULSE_PERIOD_US, DEFAULT_TTL_PULSE_COUNT,
+                        DEFAULT_TTL_BOUT_GAP_MS};
+    set_config(config);
+}
+
+TtlOutput::~TtlOutput()
+{
+    pio_sm_set_enabled(pio_, sm_, false);
+    if (program_ != nullptr)
+        pio_remove_program(pio_, program_, program_offset_);
+    pio_sm_unclaim(pio_, sm_);
+}
+
+void TtlOutput::load_program(const pio_program_t* program)
+{
+    pio_sm_set_enabled(pio_, sm_, false);
+    pio_sm_clear_fifos(pio_, sm_);
+    if (program_ != nullptr)
+        pio_remove_program(pio_, program_, program_offset_);
+    program_ = program;
+    program_offset_ = pio_add_program(pio_, program_);
+    float clkdiv = float(clock_get_hz(clk_sys)) / TTL_PIO_CLK_HZ;
+    if (program_ == &ttl_level_program)
+        ttl_level_program_init(pio_, sm_, program_offset_, pin_, clkdiv);
+    else
+        ttl_pulse_train_program_init(pio_, sm_, program_offset_, pin_, clkdiv);
+    pio_sm_set_pins_with_mask(pio_, sm_, 0, 1u << pin_); // Start LOW.
+    pio_sm_set_enabled(pio_, sm_, true);
+}
+
+void TtlOutput::set_config(const ttl_config_t& config)
+{
+    config_ = config;
+    // Precompute pulse train words, accounting for program overhead.
+    uint32_t width_us = (config_.pulse_width_us < TTL_MIN_PULSE_WIDTH_US)?
+                        TTL_MIN_PULSE_WIDTH_US: config_.pulse_width_us;
+    uint32_t low_us = (config_.pulse_period_us > width_us)?
+                      config_.pulse_period_us - width_us: 0;
+    if (low_us < TTL_MIN_PULSE_LOW_US)
+        low_us = TTL_MIN_PULSE_LOW_US;
+    high_cycles_ = width_us - TTL_MIN_PULSE_WIDTH_US;
+    low_cycles_ = low_us - TTL_MIN_PULSE_LOW_US;
+    if (config_.pulse_count == 0)
+        config_.pulse_count = 1;
+    last_lick_stop_us_ = 0;
+    load_program((config_.mode == LEVEL)? &ttl_level_program:
+                                          &ttl_pulse_train_program);
+}
+
+void __core1_func(TtlOutput::push_pulse_train)(uint32_t pulse_count)
+{
+    // Drop the trigger rather than block if the FIFO cannot fit all 3 words.
+    if (pio_sm_get_tx_fifo_level(pio_, sm_) > 8 - 3)
+        return;
+    pio_sm_put(pio_, sm_, pulse_count - 1);
+    pio_sm_put(pio_, sm_, high_cycles_);
+    pio_sm_put(pio_, sm_, low_cycles_);
+}
+
+void __core1_func(TtlOutput::lick_started)()
+{
+    switch (config_.mode)
+    {
+        case LEVEL:
+        {
+            if (!pio_sm_is_tx_fifo_full(pio_, sm_))
+                pio_sm_put(pio_, sm_, 1);
+            break;
+        }
+        case PULSE:
+        {
+            push_pulse_train(1);
+            break;
+        }
+        case PULSE_TRAIN:
+        {
+            push_pulse_train(config_.pulse_count);
+            break;
+        }
+        case BOUT_ONE_SHOT:
+        {
+            // Only pulse on the first lick of a bout.
+            if ((time_us_64() - last_lick_stop_us_)
+                >= uint64_t(config_.bout_gap_ms) * 1000)
+                push_pulse_train(1);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void __core1_func(TtlOutput::lick_stopped)()
+{
+    if (config_.mode == LEVEL)
+    {
+        if (!pio_sm_is_tx_fifo_full(pio_, sm_))
+            pio_sm_put(pio_, sm_, 0);
+    }
+    else if (config_.mode == BOUT_ONE_SHOT)
+        last_lick_stop_us_ = time_us_64();
+}
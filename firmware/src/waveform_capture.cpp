@@ -0,0 +1,120 @@
+#include <waveform_capture.h>
+
+WaveformCapture::WaveformCapture()
+:state_{IDLE}, pre_trigger_periods_{0}, post_trigger_periods_{0},
+ head_{0}, filled_{0}, remaining_{0},
+ first_slot_{0}, period_count_{0}, trigger_index_{0},
+ capture_finished_{false}
+{
+    configure(ADS7049_MIN_SAMPLES_PER_PERIOD);
+}
+
+WaveformCapture::~WaveformCapture(){}
+
+void WaveformCapture::configure(size_t samples_per_period)
+{
+    state_ = IDLE;
+    samples_per_period_ = samples_per_period;
+    capacity_periods_ = WAVEFORM_RING_SAMPLES / samples_per_period;
+    head_ = 0;
+    filled_ = 0;
+    period_count_ = 0;
+    trigger_index_ = 0;
+    capture_finished_ = false;
+}
+
+void WaveformCapture::arm(size_t pre_trigger_periods,
+                          size_t post_trigger_periods)
+{
+    // Leave room for the trigger period itself.
+    if (post_trigger_periods >= capacity_periods_)
+        post_trigger_periods = capacity_periods_ - 1;
+    if (pre_trigger_periods + post_trigger_periods >= capacity_periods_)
+        pre_trigger_periods = capacity_periods_ - 1 - post_trigger_periods;
+    pre_trigger_periods_ = pre_trigger_periods;
+    post_trigger_periods_ = post_trigger_periods;
+    head_ = 0;
+    filled_ = 0;
+    period_count_ = 0;
+    trigger_index_ = 0;
+    capture_finished_ = false;
+    state_ = ARMED;
+}
+
+void __core1_func(WaveformCapture::trigger)()
+{
+    if (state_ != ARMED || filled_ == 0)
+        return;
+    // Snapshot starts up to pre_trigger_periods_ before the latest period.
+    trigger_index_ = (filled_ - 1 < pre_trigger_periods_)?
+                     filled_ - 1:
+                     pre_trigger_periods_;
+    size_t trigger_slot = (head_ == 0)? capacity_periods_ - 1: head_ - 1;
+    first_slot_ = (trigger_slot >= trigger_index_)?
+                  trigger_slot - trigger_index_:
+                  trigger_slot + capacity_periods_ - trigger_index_;
+    period_count_ = trigger_index_ + 1;
+    remaining_ = post_trigger_periods_;
+    state_ = TRIGGERED;
+    if (remaining_ == 0)
+    {
+        state_ = READY;
+        capture_finished_ = true;
+    }
+}
+
+void __core1_func(WaveformCapture::record)(const uint16_t* samples,
+                                            uint32_t raw_amplitude)
+{
+    uint16_t* dest = samples_ + head_ * samples_per_period_;
+    for (size_t i = 0; i < samples_per_period_; ++i)
+        dest[i] = samples[i];
+    amplitudes_[head_] = (raw_amplitude > 0xFFFF)? 0xFFFF: raw_amplitude;
+    head_ = (head_ + 1 == capacity_periods_)? 0: head_ + 1;
+    if (filled_ < capacity_periods_)
+        ++filled_;
+    if (state_ != TRIGGERED)
+        return;
+    ++period_count_;
+    if (--remaining_)
+        return;
+    state_ = READY;
+    capture_finished_ = true;
+}
+
+void WaveformCapture::copy_samples(uint32_t start, uint16_t* dest,
+                                   size_t count)
+{
+    size_t snapshot_samples = period_count_ * samples_per_period_;
+    size_t ring_samples = capacity_periods_ * samples_per_period_;
+    size_t first_sample = first_slot_ * samples_per_period_;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t index = start + i;
+        if (state_ != READY || index >= snapshot_samples)
+        {
+            dest[i] = 0;
+            continue;
+        }
+        index += first_sample;
+        dest[i] = samples_[(index >= ring_samples)? index - ring_samples:
+                                                    index];
+    }
+}
+
+void WaveformCapture::copy_amplitudes(uint32_t start, uint16_t* dest,
+                                      size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t index = start + i;
+        if (state_ != READY || index >= period_count_)
+        {
+            dest[i] = 0;
+            continue;
+        }
+        index += first_slot_;
+        dest[i] = amplitudes_[(index >= capacity_periods_)?
+                              index - capacity_periods_: index];
+    }
+}
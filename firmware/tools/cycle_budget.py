@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Check core1's PROFILE_CPU cycle counts against a checked-in budget.
+
+Usage: cycle_budget.py <budget_file> <build> [log] [--skip N]
+                       [--period SAMPLES RATE_HZ] [--update [MARGIN]]
+
+Reads the "core1 cycles/loop: <n> || max: <worst>" lines that PROFILE_CPU
+builds print to uart0, from a capture file or stdin (i.e: a serial port on a
+board, or the uart0 output of an emulator), and compares the worst case
+against:
+  * the hard limit: one period at the settings the capture was recorded with
+    (--period, default 20 samples at 2MHz), since core1 must finish each
+    update before the next period arrives.
+  * the budget listed for <build> in <budget_file>: the measured worst case
+    plus a margin. Builds that have not been measured yet ("-") are only
+    checked against the hard limit.
+The first N reports (default 4) are skipped since they include startup.
+
+With --update, records the capture's worst case as <build>'s measurement and
+sets its budget to the measurement plus MARGIN percent (default 10) instead
+of checking it.
+
+Exits with status 1 if either limit is exceeded or no reports were found.
+"""
+import math
+import re
+import sys
+
+REPORT = re.compile(r"core1 cycles/loop: (\d+) \|\| max: (\d+)")
+CPU_CLOCK_HZ = 125000000
+# Shortest period the registers accept: one period of the highest excitation
+# frequency (see write_samples_per_period() in main.cpp).
+MAX_EXCITATION_FREQ_HZ = 125000
+MAX_SAMPLE_RATE_HZ = 2000000
+MIN_SAMPLES_PER_PERIOD = MAX_SAMPLE_RATE_HZ // MAX_EXCITATION_FREQ_HZ
+DEFAULT_PERIOD = (20, 2000000)
+DEFAULT_MARGIN_PERCENT = 10
+
+
+def period_cycles(samples_per_period, sample_rate_hz):
+    return (samples_per_period * CPU_CLOCK_HZ) // sample_rate_hz
+
+
+def read_budget(path, build):
+    """Return (measured, budget) for build. Either may be None if unset."""
+    with open(path) as budgets:
+        for line in budgets:
+            fields = line.split("#", 1)[0].split()
+            if len(fields) == 3 and fields[0] == build:
+                return tuple(None if field == "-" else int(field)
+                             for field in fields[1:])
+    sys.exit(f"cycle_budget: no budget for build '{build}' in {path}.")
+
+
+def write_budget(path, build, measured, budget):
+    with open(path) as budgets:
+        lines = budgets.readlines()
+    for i, line in enumerate(lines):
+        fields = line.split("#", 1)[0].split()
+        if len(fields) == 3 and fields[0] == build:
+            lines[i] = f"{build:<18}{measured:<10}{budget}\n"
+    with open(path, "w") as budgets:
+        budgets.writelines(lines)
+
+
+def read_worst_cases(log, skip):
+    worst = []
+    for line in log:
+        match = REPORT.search(line)
+        if match:
+            worst.append(int(match.group(2)))
+    return worst[skip:]
+
+
+def main(budget_path, build, log, skip, period, margin_percent):
+    measured, budget = read_budget(budget_path, build)
+    worst = read_worst_cases(log, skip)
+    if not worst:
+        print("cycle_budget: no PROFILE_CPU reports found.")
+        return 1
+    worst_case = max(worst)
+    hard_limit = period_cycles(*period)
+    # Shortest period (in samples at the maximum rate) that this worst case
+    # keeps up with.
+    min_samples = max(MIN_SAMPLES_PER_PERIOD,
+                      math.ceil(worst_case * MAX_SAMPLE_RATE_HZ
+                                / CPU_CLOCK_HZ))
+    print(f"cycle_budget: {build}: worst case {worst_case} cycles over "
+          f"{len(worst)} reports (hard limit: {hard_limit} at {period[0]} "
+          f"samples/period and {period[1]}Hz; budget: "
+          f"{budget if budget is not None else 'not measured'}).")
+    print(f"cycle_budget: {build} keeps up with periods down to "
+          f"{min_samples} samples at {MAX_SAMPLE_RATE_HZ}Hz (registers "
+          f"accept down to {MIN_SAMPLES_PER_PERIOD}).")
+    if worst_case > hard_limit:
+        print(f"cycle_budget: {build} exceeds one period by "
+              f"{worst_case - hard_limit} cycles, so periods are dropped.")
+        return 1
+    if margin_percent is not None:
+        new_budget = math.ceil(worst_case * (100 + margin_percent) / 100)
+        write_budget(budget_path, build, worst_case, new_budget)
+        print(f"cycle_budget: recorded {build}: measured {worst_case}, "
+              f"budget {new_budget}.")
+        return 0
+    if budget is not None and worst_case > budget:
+        print(f"cycle_budget: {build} exceeds its budget by "
+              f"{worst_case - budget} cycles (measured: {measured}).")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    args = sys.argv[1:]
+    skip = 4
+    period = DEFAULT_PERIOD
+    margin_percent = None
+    if "--skip" in args:
+        index = args.index("--skip")
+        skip = int(args[index + 1])
+        del args[index:index + 2]
+    if "--period" in args:
+        index = args.index("--period")
+        period = (int(args[index + 1]), int(args[index + 2]))
+        del args[index:index + 3]
+    if "--update" in args:
+        index = args.index("--update")
+        margin_percent = DEFAULT_MARGIN_PERCENT
+        if index + 1 < len(args) and args[index + 1].isdigit():
+            margin_percent = int(args[index + 1])
+            del args[index + 1]
+        del args[index]
+    if len(args) not in (2, 3):
+        sys.exit(__doc__)
+    if len(args) == 3:
+        with open(args[2], errors="replace") as log:
+            sys.exit(main(args[0], args[1], log, skip, period,
+                          margin_percent))
+    sys.exit(main(args[0], args[1], sys.stdin, skip, period, margin_percent))
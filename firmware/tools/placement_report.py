@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Report which memory region each of core1's hot path symbols landed in.
+
+Usage: placement_report.py <nm> <elf> <output>
+
+Generated with every build so that CORE1_IN_SRAM builds can be checked for
+core1 code or data that still executes from (or lives in) XIP flash.
+
+Also checks that core1's data in SCRATCH_X leaves room for core1's stack,
+which the pico-sdk places at the top of the same bank. Exits with status 1
+(failing the build) if it does not.
+"""
+import re
+import subprocess
+import sys
+
+# RP2040 memory regions (see the pico-sdk's memmap_default.ld).
+REGIONS = [
+    ("FLASH", 0x10000000, 0x11000000),
+    ("SRAM", 0x20000000, 0x20040000),
+    ("SCRATCH_X", 0x20040000, 0x20041000),
+    ("SCRATCH_Y", 0x20041000, 0x20042000),
+]
+
+# Symbols that core1 touches every sample period.
+CORE1_SYMBOLS = re.compile(
+    r"^(LickDetector::(update|update_\w+)\b"
+    r"|AmplitudeEstimator::(update|get_raw_amplitude|update_\w+)\b"
+    r"|TtlOutput::(lick_started|lick_stopped|push_pulse_train)\b"
+    r"|AD9833::service\b|FrequencySweep::update\b"
+    r"|core1_main$|flag_update$|get_sample_clock$"
+    r"|adc1?_vals$|estimators$|lick_detectors$|detector_state_bits$"
+    r"|ttl_output$|update_due$|sample_clock$"
+    r"|(new_)?lick_states$|lick_event$|lick_features_event$"
+    r"|stopped_detectors$|enabled_(detectors|channels)$)")
+
+
+# pico-sdk's core1 stack (PICO_CORE1_STACK_SIZE bytes, in SCRATCH_X).
+CORE1_STACK_SYMBOL = "core1_stack"
+DEFAULT_CORE1_STACK_SIZE = 0x800
+
+
+def region_size(name):
+    for region, start, stop in REGIONS:
+        if region == name:
+            return stop - start
+
+
+def region_of(address):
+    for name, start, stop in REGIONS:
+        if start <= address < stop:
+            return name
+    return "OTHER"
+
+
+def main(nm, elf, output):
+    lines = subprocess.run([nm, "-C", "-S", "--defined-only", elf],
+                           check=True, capture_output=True,
+                           text=True).stdout.splitlines()
+    totals = {}
+    core1 = []
+    scratch_x_data = 0
+    core1_stack_size = None
+    for line in lines:
+        fields = line.split(maxsplit=3)
+        if len(fields) != 4: # Symbols without a size are labels.
+            continue
+        address, size, _, name = int(fields[0], 16), int(fields[1], 16), \
+                                 fields[2], fields[3]
+        region = region_of(address)
+        totals[region] = totals.get(region, 0) + size
+        if name == CORE1_STACK_SYMBOL:
+            core1_stack_size = size
+        elif region == "SCRATCH_X":
+            scratch_x_data += size
+        if CORE1_SYMBOLS.match(name):
+            core1.append((region, address, size, name))
+    if core1_stack_size is None: # core1 not launched with the default stack.
+        core1_stack_size = DEFAULT_CORE1_STACK_SIZE
+    scratch_x_free = region_size("SCRATCH_X") - scratch_x_data \
+                     - core1_stack_size
+    with open(output, "w") as report:
+        report.write("Bytes per region (sized symbols only):\n")
+        for region, size in sorted(totals.items()):
+            report.write(f"  {region:<10} {size:>8}\n")
+        report.write(f"\nSCRATCH_X: {scratch_x_data} bytes of core1 data + "
+                     f"{core1_stack_size} bytes of core1 stack, "
+                     f"{scratch_x_free} bytes free.\n")
+        report.write("\nCore1 hot path:\n")
+        for region, address, size, name in sorted(core1, key=lambda s: s[1]):
+            report.write(f"  {region:<10} 0x{address:08x} {size:>6}  {name}\n")
+    in_flash = [s for s in core1 if s[0] == "FLASH"]
+    if in_flash:
+        print(f"placement_report: {len(in_flash)} core1 hot path symbol(s) "
+              f"in FLASH. See {output}.")
+    if scratch_x_free < 0:
+        print(f"placement_report: core1 data in SCRATCH_X "
+              f"({scratch_x_data} bytes) leaves {-scratch_x_free} bytes too "
+              f"few for core1's {core1_stack_size} byte stack. Move data out "
+              f"of __core1_data() or reduce PICO_CORE1_STACK_SIZE.")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 4:
+        sys.exit(__doc__)
+    sys.exit(main(*sys.argv[1:]))
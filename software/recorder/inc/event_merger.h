@@ -0,0 +1,181 @@
+#ifndef EVENT_MERGER_H
+#define EVENT_MERGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <harp_frame_parser.h>
+
+#define MERGE_MAX_PAYLOAD_SIZE (256) // longer payloads are not merged.
+#define MERGE_DEFAULT_CAPACITY (65536) // messages buffered across devices.
+#define MERGE_DEFAULT_LATENCY_US (20000) // how long a message waits for
+                                         // earlier ones from other devices.
+
+// Header of one merged message, followed by payload_size bytes of payload.
+// This is also the wire format published to subscribers (one datagram per
+// message).
+struct merged_event_header_t
+{
+    uint64_t timestamp_us; // harp time.
+    uint16_t device; // index of the device in the order it was listed.
+    uint8_t message_type; // a harp_message_type_t.
+    uint8_t address;
+    uint8_t payload_type; // harp payload type, without the timestamp flag.
+    uint8_t reserved;
+    uint16_t payload_size; // in bytes.
+};
+
+static_assert(sizeof(merged_event_header_t) == 16);
+
+struct merged_event_t
+{
+    merged_event_header_t header;
+    uint8_t payload[MERGE_MAX_PAYLOAD_SIZE];
+};
+
+// General strategy:
+// Devices that share a HarpSynchronizer share a clock, so their timestamps
+// can be compared directly. Messages do not arrive in timestamp order, even
+// from one device (i.e: lick events are stamped with the period they were
+// detected in, which precedes their dispatch), so timestamped messages are
+// held in a min-heap.
+// The current harp time is estimated from the host clock and the latest
+// message from each device; a delayed message only makes its device's
+// estimate run late, so the newest estimate across devices is used.
+// A message is released once the estimated harp time passes its timestamp
+// by the merge latency. By then, any earlier message is assumed to have
+// arrived.
+// Messages live in a pool allocated up front. If the pool fills, the
+// earliest messages are released early. Messages that arrive after a later
+// one was already released are still released (immediately), but counted as
+// late.
+
+class EventMerger
+{
+public:
+    EventMerger(size_t device_count,
+                uint64_t latency_us = MERGE_DEFAULT_LATENCY_US,
+                size_t capacity = MERGE_DEFAULT_CAPACITY);
+
+/**
+ * \brief buffer a message from \p device that arrived at \p host_time_us.
+ * \return false if the message was skipped (no timestamp or a payload longer
+ *  than MERGE_MAX_PAYLOAD_SIZE).
+ */
+    template <typename Callback>
+    bool push(size_t device, const harp_frame_t& frame, uint64_t host_time_us,
+              Callback&& on_event);
+
+/**
+ * \brief call \p on_event, in timestamp order, with every message whose
+ *  merge latency has elapsed at \p host_time_us.
+ */
+    template <typename Callback>
+    void release(uint64_t host_time_us, Callback&& on_event);
+
+/**
+ * \brief release everything still buffered, ie: on shutdown.
+ */
+    template <typename Callback>
+    void release_all(Callback&& on_event);
+
+    inline size_t buffered_count() const {return heap_.size();}
+    inline uint64_t late_count() const {return late_count_;}
+    inline uint64_t overflow_count() const {return overflow_count_;}
+    inline uint64_t skipped_count() const {return skipped_count_;}
+
+private:
+/**
+ * \brief estimated harp time at \p host_time_us, or 0 if no device has
+ *  sent a timestamped message yet.
+ */
+    uint64_t harp_time_estimate_us(uint64_t host_time_us) const;
+
+    bool earlier(uint32_t a, uint32_t b) const; // heap ordering.
+    void heap_push(uint32_t slot);
+    uint32_t heap_pop();
+
+    template <typename Callback>
+    void emit(uint32_t slot, Callback&& on_event);
+
+    uint64_t latency_us_;
+    std::vector<merged_event_t> pool_;
+    std::vector<uint32_t> free_slots_;
+    std::vector<uint32_t> heap_; // pool slots, earliest timestamp first.
+    std::vector<uint64_t> sequence_; // per slot. Keeps ties in arrival order.
+    uint64_t next_sequence_;
+
+    std::vector<int64_t> clock_offsets_us_; // per device. Harp minus host
+                                            // time at the latest message.
+    std::vector<bool> clock_valid_;
+    uint64_t last_released_us_;
+
+    uint64_t late_count_;
+    uint64_t overflow_count_;
+    uint64_t skipped_count_;
+};
+
+template <typename Callback>
+bool EventMerger::push(size_t device, const harp_frame_t& frame,
+                       uint64_t host_time_us, Callback&& on_event)
+{
+    if (!frame.has_timestamp || frame.payload_size > MERGE_MAX_PAYLOAD_SIZE
+        || device >= clock_offsets_us_.size())
+    {
+        ++skipped_count_;
+        return false;
+    }
+    clock_offsets_us_[device] = int64_t(frame.timestamp_us)
+                                - int64_t(host_time_us);
+    clock_valid_[device] = true;
+    if (free_slots_.empty()) // Make room by releasing the earliest message.
+    {
+        ++overflow_count_;
+        emit(heap_pop(), on_event);
+    }
+    uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    merged_event_t& event = pool_[slot];
+    event.header.timestamp_us = frame.timestamp_us;
+    event.header.device = device;
+    event.header.message_type = frame.message_type;
+    event.header.address = frame.address;
+    event.header.payload_type = frame.payload_type;
+    event.header.reserved = 0;
+    event.header.payload_size = frame.payload_size;
+    memcpy(event.payload, frame.payload, frame.payload_size);
+    sequence_[slot] = next_sequence_++;
+    heap_push(slot);
+    return true;
+}
+
+template <typename Callback>
+void EventMerger::release(uint64_t host_time_us, Callback&& on_event)
+{
+    uint64_t harp_time_us = harp_time_estimate_us(host_time_us);
+    while (!heap_.empty()
+           && pool_[heap_.front()].header.timestamp_us + latency_us_
+              <= harp_time_us)
+        emit(heap_pop(), on_event);
+}
+
+template <typename Callback>
+void EventMerger::release_all(Callback&& on_event)
+{
+    while (!heap_.empty())
+        emit(heap_pop(), on_event);
+}
+
+template <typename Callback>
+void EventMerger::emit(uint32_t slot, Callback&& on_event)
+{
+    const merged_event_t& event = pool_[slot];
+    if (event.header.timestamp_us < last_released_us_)
+        ++late_count_;
+    else
+        last_released_us_ = event.header.timestamp_us;
+    on_event(event);
+    free_slots_.push_back(slot);
+}
+
+#endif // EVENT_MERGER_H
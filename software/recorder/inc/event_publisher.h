@@ -0,0 +1,54 @@
+#ifndef EVENT_PUBLISHER_H
+#define EVENT_PUBLISHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <event_merger.h>
+
+#define PUBLISHER_MAX_SUBSCRIBERS (64)
+
+// General strategy:
+// Subscribers connect to a Unix domain SOCK_SEQPACKET socket, which keeps
+// message boundaries, so every merged message is one datagram: a
+// merged_event_header_t followed by the payload. Sends never block. A
+// subscriber that can't keep up (its socket buffer is full) is disconnected
+// rather than stalling the devices or everyone else.
+
+class EventPublisher
+{
+public:
+/**
+ * \brief listen on \p path, replacing any stale socket file there.
+ * \throws std::runtime_error if the socket cannot be created.
+ */
+    EventPublisher(const char* path);
+    ~EventPublisher();
+
+/**
+ * \brief listening socket. Poll it for input, then call accept_subscriber().
+ */
+    inline int fd() const {return listen_fd_;}
+
+/**
+ * \brief accept a pending subscriber, if any.
+ */
+    void accept_subscriber();
+
+/**
+ * \brief send one message to every subscriber.
+ */
+    void publish(const merged_event_t& event);
+
+    inline size_t subscriber_count() const {return subscriber_fds_.size();}
+    inline uint64_t dropped_subscriber_count() const
+        {return dropped_subscriber_count_;}
+
+private:
+    const char* path_;
+    int listen_fd_;
+    std::vector<int> subscriber_fds_;
+    uint64_t dropped_subscriber_count_;
+};
+
+#endif // EVENT_PUBLISHER_H
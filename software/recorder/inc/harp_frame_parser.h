@@ -0,0 +1,123 @@
+#ifndef HARP_FRAME_PARSER_H
+#define HARP_FRAME_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HARP_MAX_FRAME_SIZE (1024) // Longer frames are treated as corrupt.
+#define HARP_PARSER_BUFFER_SIZE (16384) // Must be >= HARP_MAX_FRAME_SIZE.
+#define HARP_HAS_TIMESTAMP (0x10) // payload type flag.
+#define HARP_TIMESTAMP_TICK_US (32) // resolution of the timestamp subseconds.
+
+enum harp_message_type_t: uint8_t
+{
+    HARP_READ = 1,
+    HARP_WRITE = 2,
+    HARP_EVENT = 3,
+    HARP_READ_ERROR = 9,
+    HARP_WRITE_ERROR = 10
+};
+
+// One decoded Harp frame. Fields point into the parser's buffer, so a frame
+// is only valid for the duration of the callback it is passed to.
+struct harp_frame_t
+{
+    uint8_t message_type;
+    uint8_t address;
+    uint8_t port;
+    uint8_t payload_type; // without the HARP_HAS_TIMESTAMP flag.
+    bool has_timestamp;
+    uint64_t timestamp_us; // harp time. 0 if the frame has no timestamp.
+    const uint8_t* payload;
+    size_t payload_size; // in bytes.
+};
+
+enum harp_parse_result_t
+{
+    HARP_FRAME_OK,
+    HARP_FRAME_INCOMPLETE, // need more bytes.
+    HARP_FRAME_INVALID // not the start of a valid frame.
+};
+
+/**
+ * \brief decode one frame from the start of \p data.
+ * \param[out] frame decoded frame. Only valid if HARP_FRAME_OK is returned.
+ * \param[out] frame_size bytes the frame occupies in \p data.
+ */
+harp_parse_result_t parse_harp_frame(const uint8_t* data, size_t size,
+                                     harp_frame_t& frame, size_t& frame_size);
+
+/**
+ * \brief size of one payload element in bytes for a harp payload type.
+ */
+inline size_t harp_element_size(uint8_t payload_type)
+{return payload_type & 0x0F;}
+
+// General strategy:
+// Bytes from the serial port are appended to a fixed buffer. Complete frames
+// are decoded in place and handed to the callback without copying. Anything
+// that does not checksum is skipped one byte at a time until the parser finds
+// the start of a valid frame again. Nothing is allocated after construction.
+
+class HarpFrameParser
+{
+public:
+    HarpFrameParser();
+
+/**
+ * \brief parse a chunk of the byte stream and call \p on_frame with every
+ *  complete frame. Partial frames are kept until the next call.
+ */
+    template <typename Callback>
+    void feed(const uint8_t* data, size_t size, Callback&& on_frame);
+
+    inline uint64_t frame_count() const {return frame_count_;}
+    inline uint64_t dropped_byte_count() const {return dropped_byte_count_;}
+
+private:
+    uint8_t buffer_[HARP_PARSER_BUFFER_SIZE];
+    size_t buffered_;
+    uint64_t frame_count_;
+    uint64_t dropped_byte_count_;
+};
+
+template <typename Callback>
+void HarpFrameParser::feed(const uint8_t* data, size_t size,
+                           Callback&& on_frame)
+{
+    harp_frame_t frame;
+    size_t frame_size;
+    while (size)
+    {
+        size_t chunk = HARP_PARSER_BUFFER_SIZE - buffered_;
+        if (chunk > size)
+            chunk = size;
+        memcpy(buffer_ + buffered_, data, chunk);
+        buffered_ += chunk;
+        data += chunk;
+        size -= chunk;
+        size_t offset = 0;
+        while (offset < buffered_)
+        {
+            harp_parse_result_t result = parse_harp_frame(
+                buffer_ + offset, buffered_ - offset, frame, frame_size);
+            if (result == HARP_FRAME_INCOMPLETE)
+                break;
+            if (result == HARP_FRAME_INVALID)
+            {
+                ++offset; // Resynchronize.
+                ++dropped_byte_count_;
+                continue;
+            }
+            on_frame(frame);
+            ++frame_count_;
+            offset += frame_size;
+        }
+        // Keep any partial frame for the next chunk.
+        memmove(buffer_, buffer_ + offset, buffered_ - offset);
+        buffered_ -= offset;
+    }
+}
+
+#endif // HARP_FRAME_PARSER_H
@@ -0,0 +1,11 @@
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+/**
+ * \brief open a serial port (or pseudo-terminal) in raw, non-blocking mode.
+ * \return the file descriptor.
+ * \throws std::runtime_error if the port cannot be opened or configured.
+ */
+int open_serial_port(const char* path);
+
+#endif // SERIAL_PORT_H
@@ -0,0 +1,153 @@
+#ifndef SESSION_FILE_H
+#define SESSION_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
+#include <harp_frame_parser.h>
+
+// Session file layout (all fields little-endian, everything 8-byte aligned):
+//
+//   session_file_header_t
+//   block 0: session_block_header_t
+//            uint64_t timestamp_us[row_count]   <- timestamp column
+//            values[row_count][element_count]   <- register column
+//            zero padding to a multiple of 8 bytes
+//   block 1: ...
+//
+// Each block holds consecutive messages from one register (of one message
+// type and payload shape). Blocks are only ever appended, so a file that is
+// still being recorded can be memory-mapped and read up to its last complete
+// block. Both columns of a block can be used in place as arrays.
+
+#define SESSION_FILE_MAGIC "LSREC\0\0\0"
+#define SESSION_FILE_VERSION (1)
+#define SESSION_BLOCK_MAGIC (0x4B42534Cu) // "LSBK"
+#define SESSION_BLOCK_ROWS (4096) // rows buffered per register before a write.
+#define SESSION_ALIGNMENT (8)
+
+struct session_file_header_t
+{
+    char magic[8]; // SESSION_FILE_MAGIC
+    uint32_t version;
+    uint32_t header_size; // offset of the first block.
+    uint64_t created_unix_us;
+    char source[40]; // serial port the session was recorded from.
+};
+
+struct session_block_header_t
+{
+    uint32_t magic; // SESSION_BLOCK_MAGIC
+    uint8_t message_type; // a harp_message_type_t.
+    uint8_t address;
+    uint8_t port;
+    uint8_t payload_type; // harp payload type, without the timestamp flag.
+    uint16_t element_count; // values per row.
+    uint16_t element_size; // bytes per value.
+    uint32_t row_count;
+    uint64_t block_size; // including this header and padding.
+    uint64_t reserved;
+};
+
+static_assert(sizeof(session_file_header_t) % SESSION_ALIGNMENT == 0);
+static_assert(sizeof(session_block_header_t) % SESSION_ALIGNMENT == 0);
+
+// General strategy:
+// Every register (per message type) gets a column buffer the first time it
+// is seen. Buffers are sized for SESSION_BLOCK_ROWS rows up front, so
+// appending a message only copies its timestamp and payload. A buffer is
+// written out as one block with a single writev() when it fills, when the
+// payload shape changes, or on flush().
+
+class SessionWriter
+{
+public:
+/**
+ * \brief create \p path, or append to it if it is an existing session file.
+ * \throws std::runtime_error if the file cannot be opened or is not a
+ *  session file.
+ */
+    SessionWriter(const char* path, const char* source);
+    ~SessionWriter();
+
+/**
+ * \brief append one message as a row of its register's column.
+ */
+    void append(const harp_frame_t& frame);
+
+/**
+ * \brief write out all partially-filled blocks. Call periodically so that
+ *  slow registers reach the disk.
+ */
+    void flush();
+
+    inline uint64_t row_count() const {return row_count_;}
+
+private:
+    struct Column
+    {
+        session_block_header_t header;
+        std::vector<uint64_t> timestamps;
+        std::vector<uint8_t> values;
+    };
+
+    void write_block(Column& column);
+
+    int fd_;
+    // One slot per (message type, address). Unused slots stay empty.
+    std::unique_ptr<Column> columns_[5 * 256];
+    uint64_t row_count_;
+};
+
+// General strategy:
+// Map the whole file read-only and walk its blocks. Columns are returned as
+// pointers into the mapping; nothing is copied.
+
+class SessionReader
+{
+public:
+/**
+ * \throws std::runtime_error if the file cannot be mapped or is not a
+ *  session file.
+ */
+    SessionReader(const char* path);
+    ~SessionReader();
+
+    inline const session_file_header_t& header() const
+    {return *(const session_file_header_t*)data_;}
+
+/**
+ * \brief call \p on_block(header, timestamps, values) for every complete
+ *  block in the file.
+ */
+    template <typename Callback>
+    void for_each_block(Callback&& on_block) const;
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+};
+
+template <typename Callback>
+void SessionReader::for_each_block(Callback&& on_block) const
+{
+    size_t offset = header().header_size;
+    while (offset + sizeof(session_block_header_t) <= size_)
+    {
+        const session_block_header_t& block =
+            *(const session_block_header_t*)(data_ + offset);
+        // Stop at a block that is still being written.
+        if (block.magic != SESSION_BLOCK_MAGIC || block.block_size == 0
+            || offset + block.block_size > size_)
+            break;
+        const uint64_t* timestamps = (const uint64_t*)(data_ + offset
+                                     + sizeof(session_block_header_t));
+        const uint8_t* values = (const uint8_t*)(timestamps
+                                                 + block.row_count);
+        on_block(block, timestamps, values);
+        offset += block.block_size;
+    }
+}
+
+#endif // SESSION_FILE_H
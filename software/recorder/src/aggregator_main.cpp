@@ -0,0 +1,170 @@
+#include <harp_frame_parser.h>
+#include <event_merger.h>
+#include <event_publisher.h>
+#include <serial_port.h>
+#include <sys/epoll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdexcept>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define READ_CHUNK_SIZE (65536)
+#define MAX_EPOLL_EVENTS (64)
+#define LISTEN_TAG (UINT64_MAX) // epoll tag of the subscriber socket.
+
+// Merges the messages of several devices into one stream ordered by Harp
+// timestamp and publishes it on a Unix socket. See event_merger.h and
+// event_publisher.h.
+
+namespace
+{
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int)
+{
+    stop_requested = 1;
+}
+
+uint64_t monotonic_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+struct Device
+{
+    const char* port;
+    int fd;
+    HarpFrameParser parser;
+};
+
+void print_usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [--latency-ms <ms>] <socket path> <port> "
+                    "[<port> ...]\n", name);
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    uint64_t latency_us = MERGE_DEFAULT_LATENCY_US;
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "--latency-ms") == 0)
+    {
+        latency_us = strtoull(argv[arg + 1], nullptr, 10) * 1000;
+        arg += 2;
+    }
+    if (argc - arg < 2)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const char* socket_path = argv[arg++];
+    // Parsers are large. Keep them off the stack and never move them.
+    std::vector<std::unique_ptr<Device>> devices;
+    std::unique_ptr<EventPublisher> publisher;
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    try
+    {
+        if (epoll_fd < 0)
+            throw std::runtime_error(std::string("epoll_create1 failed: ")
+                                     + strerror(errno));
+        for (; arg < argc; ++arg)
+        {
+            std::unique_ptr<Device> device(new Device);
+            device->port = argv[arg];
+            device->fd = open_serial_port(argv[arg]);
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.u64 = devices.size();
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, device->fd, &event);
+            fprintf(stderr, "device %zu: %s\n", devices.size(), argv[arg]);
+            devices.push_back(std::move(device));
+        }
+        publisher.reset(new EventPublisher(socket_path));
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = LISTEN_TAG;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, publisher->fd(), &event);
+    }
+    catch (const std::runtime_error& error)
+    {
+        fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+    signal(SIGINT, request_stop);
+    signal(SIGTERM, request_stop);
+    signal(SIGPIPE, SIG_IGN);
+
+    EventMerger merger(devices.size(), latency_us);
+    auto publish = [&publisher](const merged_event_t& event)
+        {publisher->publish(event);};
+    static uint8_t chunk[READ_CHUNK_SIZE];
+    struct epoll_event ready_events[MAX_EPOLL_EVENTS];
+    // Wake up often enough to release messages close to their deadline.
+    int timeout_ms = (latency_us / 4000 > 0)? latency_us / 4000: 1;
+    int exit_code = 0;
+    try
+    {
+        while (!stop_requested)
+        {
+            int ready = epoll_wait(epoll_fd, ready_events, MAX_EPOLL_EVENTS,
+                                   timeout_ms);
+            if (ready < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("epoll_wait failed: ")
+                                         + strerror(errno));
+            for (int i = 0; i < ready; ++i)
+            {
+                if (ready_events[i].data.u64 == LISTEN_TAG)
+                {
+                    publisher->accept_subscriber();
+                    continue;
+                }
+                size_t index = ready_events[i].data.u64;
+                Device& device = *devices[index];
+                if (ready_events[i].events & (EPOLLERR | EPOLLHUP))
+                    throw std::runtime_error(std::string(device.port)
+                                             + " disconnected.");
+                ssize_t size = read(device.fd, chunk, sizeof(chunk));
+                if (size <= 0)
+                    continue;
+                uint64_t now_us = monotonic_us();
+                device.parser.feed(chunk, size,
+                    [&](const harp_frame_t& frame)
+                    {merger.push(index, frame, now_us, publish);});
+            }
+            merger.release(monotonic_us(), publish);
+        }
+    }
+    catch (const std::runtime_error& error)
+    {
+        fprintf(stderr, "%s\n", error.what());
+        exit_code = 1;
+    }
+    merger.release_all(publish);
+    for (std::unique_ptr<Device>& device: devices)
+    {
+        close(device->fd);
+        fprintf(stderr, "%s: %llu frames, %llu bytes dropped.\n",
+                device->port,
+                (unsigned long long)device->parser.frame_count(),
+                (unsigned long long)device->parser.dropped_byte_count());
+    }
+    fprintf(stderr, "merged: %llu late, %llu released early, %llu skipped. "
+                    "%llu subscribers dropped.\n",
+            (unsigned long long)merger.late_count(),
+            (unsigned long long)merger.overflow_count(),
+            (unsigned long long)merger.skipped_count(),
+            (unsigned long long)publisher->dropped_subscriber_count());
+    publisher.reset();
+    close(epoll_fd);
+    return exit_code;
+}
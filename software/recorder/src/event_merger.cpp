@@ -0,0 +1,79 @@
+#include <event_merger.h>
+#include <utility>
+
+EventMerger::EventMerger(size_t device_count, uint64_t latency_us,
+                         size_t capacity)
+:latency_us_{latency_us}, pool_(capacity), sequence_(capacity),
+ next_sequence_{0}, clock_offsets_us_(device_count, 0),
+ clock_valid_(device_count, false), last_released_us_{0},
+ late_count_{0}, overflow_count_{0}, skipped_count_{0}
+{
+    free_slots_.reserve(capacity);
+    for (size_t i = capacity; i > 0; --i)
+        free_slots_.push_back(i - 1);
+    heap_.reserve(capacity);
+}
+
+uint64_t EventMerger::harp_time_estimate_us(uint64_t host_time_us) const
+{
+    bool valid = false;
+    int64_t offset_us = 0;
+    for (size_t i = 0; i < clock_offsets_us_.size(); ++i)
+    {
+        if (!clock_valid_[i])
+            continue;
+        if (!valid || clock_offsets_us_[i] > offset_us)
+            offset_us = clock_offsets_us_[i];
+        valid = true;
+    }
+    if (!valid)
+        return 0;
+    int64_t harp_time_us = int64_t(host_time_us) + offset_us;
+    return (harp_time_us < 0)? 0: uint64_t(harp_time_us);
+}
+
+bool EventMerger::earlier(uint32_t a, uint32_t b) const
+{
+    uint64_t a_us = pool_[a].header.timestamp_us;
+    uint64_t b_us = pool_[b].header.timestamp_us;
+    if (a_us != b_us)
+        return a_us < b_us;
+    return sequence_[a] < sequence_[b];
+}
+
+void EventMerger::heap_push(uint32_t slot)
+{
+    size_t child = heap_.size();
+    heap_.push_back(slot);
+    while (child)
+    {
+        size_t parent = (child - 1) / 2;
+        if (!earlier(heap_[child], heap_[parent]))
+            break;
+        std::swap(heap_[child], heap_[parent]);
+        child = parent;
+    }
+}
+
+uint32_t EventMerger::heap_pop()
+{
+    uint32_t top = heap_.front();
+    heap_.front() = heap_.back();
+    heap_.pop_back();
+    size_t parent = 0;
+    while (true)
+    {
+        size_t smallest = parent;
+        size_t left = 2 * parent + 1;
+        size_t right = left + 1;
+        if (left < heap_.size() && earlier(heap_[left], heap_[smallest]))
+            smallest = left;
+        if (right < heap_.size() && earlier(heap_[right], heap_[smallest]))
+            smallest = right;
+        if (smallest == parent)
+            break;
+        std::swap(heap_[parent], heap_[smallest]);
+        parent = smallest;
+    }
+    return top;
+}
@@ -0,0 +1,85 @@
+#include <event_publisher.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdexcept>
+#include <string>
+
+EventPublisher::EventPublisher(const char* path)
+:path_{path}, dropped_subscriber_count_{0}
+{
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path))
+        throw std::runtime_error(std::string("Socket path too long: ") + path);
+    listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        0);
+    if (listen_fd_ < 0)
+        throw std::runtime_error(std::string("Cannot create socket: ")
+                                 + strerror(errno));
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path); // Left behind if a previous run was killed.
+    if (bind(listen_fd_, (struct sockaddr*)&address, sizeof(address)) < 0
+        || listen(listen_fd_, PUBLISHER_MAX_SUBSCRIBERS) < 0)
+    {
+        std::string error = strerror(errno);
+        close(listen_fd_);
+        throw std::runtime_error(std::string("Cannot listen on ") + path
+                                 + ": " + error);
+    }
+}
+
+EventPublisher::~EventPublisher()
+{
+    for (int fd: subscriber_fds_)
+        close(fd);
+    close(listen_fd_);
+    unlink(path_);
+}
+
+void EventPublisher::accept_subscriber()
+{
+    int fd = accept4(listen_fd_, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+    if (subscriber_fds_.size() >= PUBLISHER_MAX_SUBSCRIBERS)
+    {
+        close(fd);
+        return;
+    }
+    subscriber_fds_.push_back(fd);
+}
+
+void EventPublisher::publish(const merged_event_t& event)
+{
+    // Header and payload go out as one datagram without being copied again.
+    struct iovec iov[2];
+    iov[0].iov_base = (void*)&event.header;
+    iov[0].iov_len = sizeof(event.header);
+    iov[1].iov_base = (void*)event.payload;
+    iov[1].iov_len = event.header.payload_size;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = iov;
+    message.msg_iovlen = 2;
+    for (size_t i = 0; i < subscriber_fds_.size();)
+    {
+        if (sendmsg(subscriber_fds_[i], &message,
+                    MSG_DONTWAIT | MSG_NOSIGNAL) >= 0)
+        {
+            ++i;
+            continue;
+        }
+        // Full (too slow) or gone. Either way, drop it.
+        close(subscriber_fds_[i]);
+        subscriber_fds_[i] = subscriber_fds_.back();
+        subscriber_fds_.pop_back();
+        ++dropped_subscriber_count_;
+    }
+}
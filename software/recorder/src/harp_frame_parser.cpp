@@ -0,0 +1,64 @@
+#include <harp_frame_parser.h>
+
+harp_parse_result_t parse_harp_frame(const uint8_t* data, size_t size,
+                                     harp_frame_t& frame, size_t& frame_size)
+{
+    if (size < 2)
+        return HARP_FRAME_INCOMPLETE;
+    uint8_t message_type = data[0];
+    if (message_type != HARP_READ && message_type != HARP_WRITE
+        && message_type != HARP_EVENT && message_type != HARP_READ_ERROR
+        && message_type != HARP_WRITE_ERROR)
+        return HARP_FRAME_INVALID;
+    // Length counts the bytes after it. 255 means a 16-bit length follows.
+    size_t header_size = 2;
+    size_t length = data[1];
+    if (length == 255)
+    {
+        if (size < 4)
+            return HARP_FRAME_INCOMPLETE;
+        length = data[2] | (size_t(data[3]) << 8);
+        header_size = 4;
+    }
+    // Smallest frame: address, port, payload type, checksum.
+    if (length < 4 || header_size + length > HARP_MAX_FRAME_SIZE)
+        return HARP_FRAME_INVALID;
+    frame_size = header_size + length;
+    if (size < frame_size)
+        return HARP_FRAME_INCOMPLETE;
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < frame_size - 1; ++i)
+        checksum += data[i];
+    if (checksum != data[frame_size - 1])
+        return HARP_FRAME_INVALID;
+    size_t offset = header_size;
+    frame.message_type = message_type;
+    frame.address = data[offset++];
+    frame.port = data[offset++];
+    uint8_t payload_type = data[offset++];
+    frame.payload_type = payload_type & ~HARP_HAS_TIMESTAMP;
+    frame.has_timestamp = bool(payload_type & HARP_HAS_TIMESTAMP);
+    frame.timestamp_us = 0;
+    if (frame.has_timestamp)
+    {
+        if (offset + 6 > frame_size - 1)
+            return HARP_FRAME_INVALID;
+        uint32_t seconds = data[offset] | (uint32_t(data[offset + 1]) << 8)
+                           | (uint32_t(data[offset + 2]) << 16)
+                           | (uint32_t(data[offset + 3]) << 24);
+        uint16_t ticks = data[offset + 4] | (uint16_t(data[offset + 5]) << 8);
+        frame.timestamp_us = uint64_t(seconds) * 1000000
+                             + uint64_t(ticks) * HARP_TIMESTAMP_TICK_US;
+        offset += 6;
+    }
+    frame.payload = data + offset;
+    frame.payload_size = frame_size - 1 - offset;
+    size_t element_size = harp_element_size(frame.payload_type);
+    if (element_size == 0 || (frame.payload_size % element_size))
+        return HARP_FRAME_INVALID;
+    return HARP_FRAME_OK;
+}
+
+HarpFrameParser::HarpFrameParser()
+:buffered_{0}, frame_count_{0}, dropped_byte_count_{0}
+{}
@@ -0,0 +1,127 @@
+#include <harp_frame_parser.h>
+#include <session_file.h>
+#include <serial_port.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdexcept>
+#include <memory>
+#include <vector>
+
+#define READ_CHUNK_SIZE (65536)
+#define FLUSH_INTERVAL_MS (1000) // longest time a message stays in memory.
+
+// Records every Harp message from one or more devices. Each device is written
+// to its own session file. See session_file.h for the format.
+
+namespace
+{
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int)
+{
+    stop_requested = 1;
+}
+
+uint64_t monotonic_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+struct Recording
+{
+    const char* port;
+    int fd;
+    HarpFrameParser parser;
+    std::unique_ptr<SessionWriter> writer;
+};
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || (argc - 1) % 2)
+    {
+        fprintf(stderr, "Usage: %s <port> <session file> "
+                        "[<port> <session file> ...]\n", argv[0]);
+        return 1;
+    }
+    // Parsers are large. Keep them off the stack and never move them.
+    std::vector<std::unique_ptr<Recording>> recordings;
+    std::vector<struct pollfd> poll_fds;
+    try
+    {
+        for (int i = 1; i < argc; i += 2)
+        {
+            std::unique_ptr<Recording> recording(new Recording);
+            recording->port = argv[i];
+            recording->fd = open_serial_port(argv[i]);
+            recording->writer.reset(new SessionWriter(argv[i + 1], argv[i]));
+            poll_fds.push_back({recording->fd, POLLIN, 0});
+            recordings.push_back(std::move(recording));
+        }
+    }
+    catch (const std::runtime_error& error)
+    {
+        fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+    signal(SIGINT, request_stop);
+    signal(SIGTERM, request_stop);
+
+    static uint8_t chunk[READ_CHUNK_SIZE];
+    uint64_t last_flush_ms = monotonic_ms();
+    int exit_code = 0;
+    try
+    {
+        while (!stop_requested)
+        {
+            int ready = poll(poll_fds.data(), poll_fds.size(),
+                             FLUSH_INTERVAL_MS);
+            if (ready < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("poll failed: ")
+                                         + strerror(errno));
+            for (size_t i = 0; ready > 0 && i < poll_fds.size(); ++i)
+            {
+                if (poll_fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+                    throw std::runtime_error(std::string(recordings[i]->port)
+                                             + " disconnected.");
+                if (!(poll_fds[i].revents & POLLIN))
+                    continue;
+                Recording& recording = *recordings[i];
+                ssize_t size = read(recording.fd, chunk, sizeof(chunk));
+                if (size <= 0)
+                    continue;
+                recording.parser.feed(chunk, size,
+                    [&recording](const harp_frame_t& frame)
+                    {recording.writer->append(frame);});
+            }
+            if (monotonic_ms() - last_flush_ms >= FLUSH_INTERVAL_MS)
+            {
+                last_flush_ms = monotonic_ms();
+                for (std::unique_ptr<Recording>& recording: recordings)
+                    recording->writer->flush();
+            }
+        }
+    }
+    catch (const std::runtime_error& error)
+    {
+        fprintf(stderr, "%s\n", error.what());
+        exit_code = 1;
+    }
+    for (std::unique_ptr<Recording>& recording: recordings)
+    {
+        recording->writer.reset(); // Flushes.
+        close(recording->fd);
+        fprintf(stderr, "%s: %llu frames, %llu bytes dropped.\n",
+                recording->port,
+                (unsigned long long)recording->parser.frame_count(),
+                (unsigned long long)recording->parser.dropped_byte_count());
+    }
+    return exit_code;
+}
@@ -0,0 +1,30 @@
+#include <serial_port.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdexcept>
+#include <string>
+
+int open_serial_port(const char* path)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+        throw std::runtime_error(std::string("Cannot open ") + path + ": "
+                                 + strerror(errno));
+    struct termios tty;
+    if (tcgetattr(fd, &tty) < 0)
+    {
+        close(fd);
+        throw std::runtime_error(std::string(path) + " is not a tty.");
+    }
+    cfmakeraw(&tty);
+    // USB CDC ignores the baud rate, but Harp devices nominally run at 1Mbaud.
+    cfsetispeed(&tty, B1000000);
+    cfsetospeed(&tty, B1000000);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tcsetattr(fd, TCSANOW, &tty);
+    tcflush(fd, TCIFLUSH); // Start from the next frame boundary we can find.
+    return fd;
+}
@@ -0,0 +1,206 @@
+#include <session_file.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+/**
+ * \brief column slot index for a message type. Error replies share their
+ *  own slots so they never interrupt a register's normal stream.
+ */
+size_t message_type_slot(uint8_t message_type)
+{
+    switch (message_type)
+    {
+        case HARP_READ: return 0;
+        case HARP_WRITE: return 1;
+        case HARP_EVENT: return 2;
+        case HARP_READ_ERROR: return 3;
+        default: return 4;
+    }
+}
+
+void write_all(int fd, struct iovec* iov, int iov_count)
+{
+    while (iov_count)
+    {
+        ssize_t written = writev(fd, iov, iov_count);
+        if (written < 0)
+            throw std::runtime_error(std::string("Session write failed: ")
+                                     + strerror(errno));
+        // Skip what was written in case of a partial write.
+        while (iov_count && size_t(written) >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            ++iov;
+            --iov_count;
+        }
+        if (iov_count)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+} // namespace
+
+SessionWriter::SessionWriter(const char* path, const char* source)
+:row_count_{0}
+{
+    fd_ = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0)
+        throw std::runtime_error(std::string("Cannot open ") + path + ": "
+                                 + strerror(errno));
+    session_file_header_t header;
+    ssize_t read_size = pread(fd_, &header, sizeof(header), 0);
+    if (read_size == 0) // New file.
+    {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SESSION_FILE_MAGIC, sizeof(header.magic));
+        header.version = SESSION_FILE_VERSION;
+        header.header_size = sizeof(header);
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        header.created_unix_us = uint64_t(now.tv_sec) * 1000000
+                                 + now.tv_nsec / 1000;
+        strncpy(header.source, source, sizeof(header.source) - 1);
+        struct iovec iov{&header, sizeof(header)};
+        write_all(fd_, &iov, 1);
+    }
+    else if (read_size != sizeof(header)
+             || memcmp(header.magic, SESSION_FILE_MAGIC, sizeof(header.magic))
+             || header.version != SESSION_FILE_VERSION)
+    {
+        close(fd_);
+        throw std::runtime_error(std::string(path)
+                                 + " is not a session file.");
+    }
+}
+
+SessionWriter::~SessionWriter()
+{
+    try
+    {
+        flush();
+    }
+    catch (const std::runtime_error&) {} // Nothing left to report to.
+    close(fd_);
+}
+
+void SessionWriter::append(const harp_frame_t& frame)
+{
+    std::unique_ptr<Column>& slot =
+        columns_[message_type_slot(frame.message_type) * 256 + frame.address];
+    size_t element_size = harp_element_size(frame.payload_type);
+    uint16_t element_count = (element_size)?
+                             frame.payload_size / element_size: 0;
+    if (!slot)
+    {
+        slot.reset(new Column);
+        slot->header.row_count = 0;
+    }
+    Column& column = *slot;
+    // Rows in a block must all have the same shape.
+    if (column.header.row_count
+        && (column.header.message_type != frame.message_type
+            || column.header.payload_type != frame.payload_type
+            || column.header.element_count != element_count))
+        write_block(column);
+    if (column.header.row_count == 0)
+    {
+        memset(&column.header, 0, sizeof(column.header));
+        column.header.magic = SESSION_BLOCK_MAGIC;
+        column.header.message_type = frame.message_type;
+        column.header.address = frame.address;
+        column.header.port = frame.port;
+        column.header.payload_type = frame.payload_type;
+        column.header.element_count = element_count;
+        column.header.element_size = element_size;
+        // Capacity only grows if a register's payload gets longer.
+        column.timestamps.reserve(SESSION_BLOCK_ROWS);
+        column.values.reserve(SESSION_BLOCK_ROWS * frame.payload_size);
+        column.timestamps.clear();
+        column.values.clear();
+    }
+    column.timestamps.push_back(frame.timestamp_us);
+    column.values.insert(column.values.end(), frame.payload,
+                         frame.payload + frame.payload_size);
+    ++column.header.row_count;
+    ++row_count_;
+    if (column.header.row_count == SESSION_BLOCK_ROWS)
+        write_block(column);
+}
+
+void SessionWriter::flush()
+{
+    for (std::unique_ptr<Column>& column: columns_)
+    {
+        if (column && column->header.row_count)
+            write_block(*column);
+    }
+}
+
+void SessionWriter::write_block(Column& column)
+{
+    static const uint8_t padding[SESSION_ALIGNMENT] = {0};
+    size_t timestamp_bytes = column.timestamps.size() * sizeof(uint64_t);
+    size_t value_bytes = column.values.size();
+    size_t padding_bytes = (SESSION_ALIGNMENT
+                            - value_bytes % SESSION_ALIGNMENT)
+                           % SESSION_ALIGNMENT;
+    column.header.block_size = sizeof(column.header) + timestamp_bytes
+                               + value_bytes + padding_bytes;
+    struct iovec iov[4]
+    {
+        {&column.header, sizeof(column.header)},
+        {column.timestamps.data(), timestamp_bytes},
+        {column.values.data(), value_bytes},
+        {(void*)padding, padding_bytes}
+    };
+    write_all(fd_, iov, 4);
+    column.header.row_count = 0;
+    column.timestamps.clear();
+    column.values.clear();
+}
+
+SessionReader::SessionReader(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(std::string("Cannot open ") + path + ": "
+                                 + strerror(errno));
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    size_ = file_stat.st_size;
+    if (size_ < sizeof(session_file_header_t))
+    {
+        close(fd);
+        throw std::runtime_error(std::string(path)
+                                 + " is not a session file.");
+    }
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open.
+    if (data == MAP_FAILED)
+        throw std::runtime_error(std::string("Cannot map ") + path + ": "
+                                 + strerror(errno));
+    data_ = (const uint8_t*)data;
+    if (memcmp(header().magic, SESSION_FILE_MAGIC, sizeof(header().magic))
+        || header().version != SESSION_FILE_VERSION)
+    {
+        munmap((void*)data_, size_);
+        throw std::runtime_error(std::string(path)
+                                 + " is not a session file.");
+    }
+}
+
+SessionReader::~SessionReader()
+{
+    munmap((void*)data_, size_);
+}
@@ -0,0 +1,62 @@
+#include <session_file.h>
+#include <stdio.h>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+// Summarizes a session file: rows and time span per register.
+
+namespace
+{
+struct ColumnSummary
+{
+    uint64_t row_count = 0;
+    uint64_t block_count = 0;
+    uint64_t first_timestamp_us = 0;
+    uint64_t last_timestamp_us = 0;
+};
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <session file>\n", argv[0]);
+        return 1;
+    }
+    try
+    {
+        SessionReader session(argv[1]);
+        // Keyed by (address, message type).
+        std::map<std::tuple<uint8_t, uint8_t>, ColumnSummary> columns;
+        session.for_each_block(
+            [&columns](const session_block_header_t& block,
+                       const uint64_t* timestamps, const uint8_t*)
+            {
+                ColumnSummary& column =
+                    columns[{block.address, block.message_type}];
+                if (block.row_count == 0)
+                    return;
+                if (column.row_count == 0)
+                    column.first_timestamp_us = timestamps[0];
+                column.last_timestamp_us = timestamps[block.row_count - 1];
+                column.row_count += block.row_count;
+                ++column.block_count;
+            });
+        printf("source: %.40s\n", session.header().source);
+        printf("address  type      rows  blocks  first [us]     last [us]\n");
+        for (const auto& [key, column]: columns)
+            printf("%7u  %4u  %8llu  %6llu  %12llu  %12llu\n",
+                   std::get<0>(key), std::get<1>(key),
+                   (unsigned long long)column.row_count,
+                   (unsigned long long)column.block_count,
+                   (unsigned long long)column.first_timestamp_us,
+                   (unsigned long long)column.last_timestamp_us);
+    }
+    catch (const std::runtime_error& error)
+    {
+        fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+    return 0;
+}